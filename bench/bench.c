@@ -0,0 +1,319 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct bench_mode {
+    const char* name;
+    int (*func)(int argc, char* argv[]);
+};
+
+static FILE* bench_results;
+
+static const struct bench_mode bench_modes[] = {
+    {"string", bench_string},
+    {"pipe", bench_pipe},
+    {"spawn", bench_spawn},
+    {"signal", bench_signal},
+    {"pthread", bench_pthread},
+    {"pthread_sync", bench_pthread_sync},
+    {"fb", bench_fb},
+    {"mmap", bench_mmap},
+    {"malloc", bench_malloc},
+    {"io", bench_io},
+    {"printf", bench_printf},
+    {"dir", bench_dir},
+    {"syscall", bench_syscall},
+    {"timer", bench_timer},
+    {"ctype", bench_ctype},
+    {"complexity", bench_complexity},
+    {"inet", bench_inet},
+    {"socket", bench_socket},
+    {"poll", bench_poll},
+    {"fd", bench_fd},
+};
+
+uint64_t bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * Calls func(arg) in batches of doubling size until a single batch takes at least target_ns.
+ * Returns the average time of a single call from the last batch.
+ */
+double bench_loop(void (*func)(void* arg), void* arg, uint64_t target_ns) {
+    uint64_t iters = 1;
+
+    for (;;) {
+        uint64_t start = bench_now();
+
+        for (uint64_t i = 0; i < iters; i++)
+            func(arg);
+
+        uint64_t elapsed = bench_now() - start;
+        if (elapsed >= target_ns)
+            return (double) elapsed / iters;
+
+        iters *= 2;
+    }
+}
+
+/* Parses sizes like "4096", "64K", "64M" or "4G". */
+size_t bench_size(const char* str) {
+    char*  end;
+    size_t size = strtoull(str, &end, 0);
+
+    switch (*end) {
+    case 'k':
+    case 'K':
+        return KiB(size);
+    case 'm':
+    case 'M':
+        return MiB(size);
+    case 'g':
+    case 'G':
+        return GiB(size);
+    default:
+        return size;
+    }
+}
+
+void* bench_map(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(ptr != MAP_FAILED);
+
+    return ptr;
+}
+
+void bench_unmap(void* ptr, size_t size) {
+    ASSERT(munmap(ptr, size) == 0);
+}
+
+/*
+ * Makes room for count descriptors, raising the hard limit too where that's allowed. Returns
+ * how many descriptors there is room for.
+ */
+size_t bench_nofile(size_t count) {
+    struct rlimit limit;
+
+    ASSERT(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    if (limit.rlim_cur >= count)
+        return limit.rlim_cur;
+
+    struct rlimit raised = {count, count > limit.rlim_max ? count : limit.rlim_max};
+
+    if (setrlimit(RLIMIT_NOFILE, &raised) == 0)
+        return count;
+
+    limit.rlim_cur = limit.rlim_max;
+    ASSERT(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    return limit.rlim_max;
+}
+
+void bench_report(const char* name, const char* params, const char* unit, double value) {
+    printf("%-24s %-40s %14.3f %s\n", name, params, value, unit);
+
+    if (bench_results)
+        fprintf(bench_results, "%s\t%s\t%s\t%.17g\n", name, params, unit, value);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Sorts the nanosecond samples and reports their median and tail percentiles. */
+void bench_report_dist(const char* name, const char* params, uint64_t* samples, size_t count) {
+    static const struct {
+        const char* unit;
+        double      fraction;
+    } percentiles[] = {
+        {"ns (p50)", 0.5},
+        {"ns (p99)", 0.99},
+        {"ns (p99.9)", 0.999},
+    };
+
+    if (count == 0)
+        return;
+
+    qsort(samples, count, sizeof(uint64_t), compare_u64);
+
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        size_t index = count * percentiles[i].fraction;
+        if (index >= count)
+            index = count - 1;
+
+        bench_report(name, params, percentiles[i].unit, samples[index]);
+    }
+}
+
+/* Prints a power of two histogram of the nanosecond samples. */
+void bench_report_hist(const char* name, const char* params, const uint64_t* samples,
+                       size_t count) {
+    static const char bar[] = "########################################";
+
+    size_t buckets[64] = {0};
+    size_t first       = 63;
+    size_t last        = 0;
+    size_t peak        = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t bucket = 63 - __builtin_clzll(samples[i] | 1);
+        buckets[bucket]++;
+
+        if (bucket < first)
+            first = bucket;
+
+        if (bucket > last)
+            last = bucket;
+
+        if (buckets[bucket] > peak)
+            peak = buckets[bucket];
+    }
+
+    for (size_t i = first; i <= last && count; i++) {
+        int width = buckets[i] * (sizeof(bar) - 1) / peak;
+
+        printf("%-24s %-40s [%10llu, %10llu) ns %10zu %.*s\n", name, params, 1ULL << i,
+               2ULL << i, buckets[i], width, bar);
+    }
+}
+
+static void bench_usage() {
+    size_t count = sizeof(bench_modes) / sizeof(bench_modes[0]);
+
+    fprintf(stderr, "usage: utest bench [-o results_file] [-r repetitions] <mode> [options]\n"
+                    "modes:");
+
+    for (size_t i = 0; i < count; i++)
+        fprintf(stderr, " %s", bench_modes[i].name);
+
+    fprintf(stderr, "\n");
+}
+
+/*
+ * Opens the results file for appending, so repeated runs add samples for the comparator. A new
+ * file is headed by the libc and kernel the results belong to, an existing one is only appended
+ * to if its header matches, so results of different systems never get pooled.
+ */
+static bool bench_open_results(const char* path) {
+    char           header[256];
+    char           existing[256];
+    char           libc[64] = "unknown";
+    struct utsname uts;
+
+#if defined(_CS_GNU_LIBC_VERSION)
+    if (confstr(_CS_GNU_LIBC_VERSION, libc, sizeof(libc)) == 0)
+        strcpy(libc, "unknown");
+#elif __aex__
+    strcpy(libc, "aex");
+#endif
+
+    if (uname(&uts) != 0) {
+        strcpy(uts.sysname, "unknown");
+        strcpy(uts.release, "unknown");
+    }
+
+    size_t len = snprintf(header, sizeof(header), "# utest bench results v%i\nlibc\t%s\n",
+                          BENCH_RESULTS_VERSION, libc);
+
+    len += snprintf(header + len, sizeof(header) - len, "kernel\t%s %s\n", uts.sysname,
+                    uts.release);
+
+    // reads start at the beginning, writes always go to the end
+    bench_results = fopen(path, "a+");
+
+    if (!bench_results) {
+        fprintf(stderr, "utest: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    // line buffered, so nothing is left in the buffer to be flushed twice by forked children
+    setvbuf(bench_results, NULL, _IOLBF, 0);
+
+    size_t got = fread(existing, 1, len, bench_results);
+
+    if (got > 0 && (got != len || memcmp(existing, header, len) != 0)) {
+        fprintf(stderr, "utest: %s holds results of another libc, kernel or version\n", path);
+        fclose(bench_results);
+        bench_results = NULL;
+        return false;
+    }
+
+    // going from reading to writing takes a seek, even though the writes append anyway
+    fseek(bench_results, 0, SEEK_END);
+
+    if (got == 0)
+        fputs(header, bench_results);
+
+    return true;
+}
+
+int bench_main(int argc, char* argv[]) {
+    size_t count       = sizeof(bench_modes) / sizeof(bench_modes[0]);
+    long   repetitions = 1;
+    int    arg         = 0;
+
+    // the options before the mode are parsed by hand, everything after it belongs to the mode
+    for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+        if (arg + 1 >= argc) {
+            bench_usage();
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(argv[arg], "-o") == 0) {
+            if (!bench_open_results(argv[arg + 1]))
+                return EXIT_FAILURE;
+        }
+        else if (strcmp(argv[arg], "-r") == 0)
+            repetitions = atol(argv[arg + 1]);
+        else {
+            bench_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (arg >= argc) {
+        bench_usage();
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(argv[arg], bench_modes[i].name) != 0)
+            continue;
+
+        int ret = EXIT_SUCCESS;
+
+        // every repetition adds another sample under the same keys for utest compare
+        for (long r = 0; r < repetitions && ret == EXIT_SUCCESS; r++) {
+            optind = 1;
+            ret    = bench_modes[i].func(argc - arg, argv + arg);
+        }
+
+        fflush(stdout);
+
+        if (bench_results)
+            fclose(bench_results);
+
+        return ret;
+    }
+
+    fprintf(stderr, "utest: unknown bench mode '%s'\n", argv[arg]);
+    return EXIT_FAILURE;
+}
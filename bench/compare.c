@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct series {
+    char*   key;
+    double* values;
+    size_t  count;
+    size_t  capacity;
+};
+
+/* All the samples of one results file, hashed by "name\tparams\tunit" */
+struct results {
+    char           libc[64];
+    char           kernel[128];
+    struct series* table;
+    size_t         size;
+    size_t         used;
+};
+
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (; *key; key++)
+        hash = (hash ^ (unsigned char) *key) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+static struct series* results_find(struct results* res, const char* key, bool create) {
+    if (create && (res->used + 1) * 2 > res->size) {
+        struct series* old  = res->table;
+        size_t         size = res->size;
+
+        res->size  = size ? size * 2 : 1024;
+        res->table = calloc(res->size, sizeof(struct series));
+        ASSERT(res->table);
+
+        for (size_t i = 0; i < size; i++) {
+            if (!old[i].key)
+                continue;
+
+            size_t j = hash_key(old[i].key) & (res->size - 1);
+
+            while (res->table[j].key)
+                j = (j + 1) & (res->size - 1);
+
+            res->table[j] = old[i];
+        }
+
+        free(old);
+    }
+
+    if (!res->size)
+        return NULL;
+
+    size_t i = hash_key(key) & (res->size - 1);
+
+    for (; res->table[i].key; i = (i + 1) & (res->size - 1))
+        if (strcmp(res->table[i].key, key) == 0)
+            return &res->table[i];
+
+    if (!create)
+        return NULL;
+
+    res->table[i].key = strdup(key);
+    ASSERT(res->table[i].key);
+    res->used++;
+
+    return &res->table[i];
+}
+
+static void results_free(struct results* res) {
+    for (size_t i = 0; i < res->size; i++) {
+        free(res->table[i].key);
+        free(res->table[i].values);
+    }
+
+    free(res->table);
+}
+
+static bool results_load(struct results* res, const char* path) {
+    FILE* file = fopen(path, "r");
+
+    if (!file) {
+        fprintf(stderr, "utest: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    char*  line    = NULL;
+    size_t len     = 0;
+    int    version = 0;
+    bool   ok      = true;
+
+    memset(res, 0, sizeof(*res));
+
+    if (getline(&line, &len, file) == -1 ||
+        sscanf(line, "# utest bench results v%i", &version) != 1 ||
+        version != BENCH_RESULTS_VERSION) {
+        fprintf(stderr, "utest: %s isn't a v%i results file\n", path, BENCH_RESULTS_VERSION);
+
+        free(line);
+        fclose(file);
+        return false;
+    }
+
+    while (getline(&line, &len, file) != -1) {
+        line[strcspn(line, "\n")] = '\0';
+
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+
+        // a second header, as from concatenated files, has to name the same system as the first
+        char*  field = NULL;
+        size_t size  = 0;
+
+        if (strncmp(line, "libc\t", 5) == 0) {
+            field = res->libc;
+            size  = sizeof(res->libc);
+        }
+        else if (strncmp(line, "kernel\t", 7) == 0) {
+            field = res->kernel;
+            size  = sizeof(res->kernel);
+        }
+
+        if (field) {
+            const char* value = strchr(line, '\t') + 1;
+
+            if (field[0] && strncmp(field, value, size - 1) != 0) {
+                fprintf(stderr, "utest: %s mixes results of %s and %s\n", path, field, value);
+                ok = false;
+                break;
+            }
+
+            snprintf(field, size, "%s", value);
+            continue;
+        }
+
+        // the key is everything up to the last tab, the value comes after it
+        char* value = strrchr(line, '\t');
+        if (!value)
+            continue;
+
+        *value++ = '\0';
+
+        struct series* series = results_find(res, line, true);
+
+        if (series->count == series->capacity) {
+            series->capacity = series->capacity ? series->capacity * 2 : 4;
+            series->values   = realloc(series->values, series->capacity * sizeof(double));
+            ASSERT(series->values);
+        }
+
+        series->values[series->count++] = strtod(value, NULL);
+    }
+
+    free(line);
+    fclose(file);
+
+    if (!ok) {
+        results_free(res);
+        return false;
+    }
+
+    if (!res->libc[0])
+        strcpy(res->libc, "unknown");
+
+    if (!res->kernel[0])
+        strcpy(res->kernel, "unknown");
+
+    return true;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+static double median(const struct series* series) {
+    double* sorted = malloc(series->count * sizeof(double));
+    ASSERT(sorted);
+
+    memcpy(sorted, series->values, series->count * sizeof(double));
+    qsort(sorted, series->count, sizeof(double), compare_double);
+
+    size_t n   = series->count;
+    double mid = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+
+    free(sorted);
+    return mid;
+}
+
+struct ranked {
+    double value;
+    int    group;
+};
+
+static int compare_ranked(const void* a, const void* b) {
+    return compare_double(&((const struct ranked*) a)->value, &((const struct ranked*) b)->value);
+}
+
+/*
+ * Two-sided Mann-Whitney U test using the normal approximation, with the tie correction and a
+ * continuity correction. Returns the p-value of the two series coming from the same distribution.
+ */
+static double mann_whitney(const struct series* a, const struct series* b) {
+    size_t         n1  = a->count;
+    size_t         n2  = b->count;
+    size_t         n   = n1 + n2;
+    struct ranked* all = malloc(n * sizeof(struct ranked));
+
+    ASSERT(all);
+
+    for (size_t i = 0; i < n1; i++)
+        all[i] = (struct ranked){a->values[i], 0};
+
+    for (size_t i = 0; i < n2; i++)
+        all[n1 + i] = (struct ranked){b->values[i], 1};
+
+    qsort(all, n, sizeof(struct ranked), compare_ranked);
+
+    double rank_sum = 0;
+    double ties     = 0;
+
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+
+        while (j < n && all[j].value == all[i].value)
+            j++;
+
+        // tied values all get the average of the ranks they span
+        double rank = (i + 1 + j) / 2.0;
+        double t    = j - i;
+
+        for (size_t k = i; k < j; k++)
+            if (all[k].group == 0)
+                rank_sum += rank;
+
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    free(all);
+
+    double u     = rank_sum - n1 * (n1 + 1) / 2.0;
+    double mean  = n1 * n2 / 2.0;
+    double var   = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1.0)));
+    double delta = fabs(u - mean);
+
+    if (var <= 0)
+        return 1;
+
+    double z = (delta > 0.5 ? delta - 0.5 : 0) / sqrt(var);
+    return erfc(z / sqrt(2));
+}
+
+/*
+ * The smallest p-value mann_whitney() can return for n1 and n2 samples, when the two series don't
+ * overlap at all. If even that isn't below alpha, the test can never find a difference.
+ */
+static double mann_whitney_floor(size_t n1, size_t n2) {
+    double var = n1 * n2 / 12.0 * (n1 + n2 + 1);
+    double z   = (n1 * n2 / 2.0 - 0.5) / sqrt(var);
+
+    return erfc(z / sqrt(2));
+}
+
+/* Throughput-like units are better when higher, latencies and costs when lower */
+static bool higher_is_better(const char* key) {
+    const char* unit = strrchr(key, '\t') + 1;
+    return strstr(unit, "/s") || strncmp(unit, "fairness", 8) == 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest compare [-t threshold_%%] [-a alpha] [-v] old new\n");
+}
+
+/*
+ * Compares every benchmark present in both results files. A benchmark regressed if its median got
+ * worse by more than the threshold and, given enough repetitions, the Mann-Whitney test says the
+ * difference is significant. With too few repetitions for the test to ever get below alpha, the
+ * threshold alone decides.
+ */
+int bench_compare(int argc, char* argv[]) {
+    double threshold = 5;
+    double alpha     = 0.05;
+    bool   verbose   = false;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "t:a:v")) != -1) {
+        switch (opt) {
+        case 't':
+            threshold = strtod(optarg, NULL);
+            break;
+        case 'a':
+            alpha = strtod(optarg, NULL);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct results old, new;
+
+    if (!results_load(&old, argv[optind]) || !results_load(&new, argv[optind + 1]))
+        return EXIT_FAILURE;
+
+    printf("old: %s, %s\n", old.libc, old.kernel);
+    printf("new: %s, %s\n", new.libc, new.kernel);
+
+    size_t regressed = 0;
+    size_t improved  = 0;
+    size_t compared  = 0;
+
+    for (size_t i = 0; i < new.size; i++) {
+        struct series* after  = &new.table[i];
+        struct series* before = after->key ? results_find(&old, after->key, false) : NULL;
+
+        if (!before)
+            continue;
+
+        double old_median = median(before);
+        double new_median = median(after);
+        double change     = old_median ? (new_median - old_median) / fabs(old_median) * 100 : 0;
+        double worse      = higher_is_better(after->key) ? -change : change;
+        bool   few        = mann_whitney_floor(before->count, after->count) >= alpha;
+        double p          = few ? NAN : mann_whitney(before, after);
+        bool   signif     = few || p < alpha;
+
+        const char* status = "ok";
+
+        if (signif && worse > threshold) {
+            status = "REGRESSED";
+            regressed++;
+        }
+        else if (signif && -worse > threshold) {
+            status = "improved";
+            improved++;
+        }
+
+        compared++;
+
+        if (!verbose && strcmp(status, "ok") == 0)
+            continue;
+
+        // print the key with spaces, the same way the benchmarks print it
+        char key[256];
+        snprintf(key, sizeof(key), "%s", after->key);
+
+        for (char* c = key; *c; c++)
+            if (*c == '\t')
+                *c = ' ';
+
+        printf("%-9s %s: %.3f -> %.3f (%+.2f%%, p = %.4f, n = %zu/%zu)\n", status, key, old_median,
+               new_median, change, p, before->count, after->count);
+    }
+
+    printf("%zu compared, %zu regressed, %zu improved (threshold %.2f%%, alpha %.3f)\n", compared,
+           regressed, improved, threshold, alpha);
+
+    results_free(&old);
+    results_free(&new);
+
+    return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* How much steeper than expected a probe may grow before it's flagged */
+#define COMPLEXITY_SLACK 0.5
+
+/* Input length of the set probes, only the set grows there */
+#define COMPLEXITY_SET_INPUT KiB(64)
+
+struct complexity_ctx {
+    char*  input;
+    char*  work;
+    char*  pattern;
+    size_t size;
+    size_t pattern_len;
+};
+
+struct complexity_probe {
+    const char* name;
+    const char* params;
+    void (*setup)(struct complexity_ctx* ctx, size_t n);
+    void (*func)(void* arg);
+    bool   set_axis;
+    double expected;
+};
+
+/*
+ * Sets start at 32 so the fast paths for short sets, like glibc's SSE4.2 one up to 16 bytes,
+ * don't read as growth. 254 is the largest set a reject probe can use and still leave a byte
+ * outside of it.
+ */
+static const size_t complexity_sets[] = {32, 64, 128, 254};
+
+/*
+ * A haystack of n 'a's and a needle of n/2 - 1 'a's and a 'b'. Every position almost matches,
+ * so comparing the needle at every position costs n^2 / 4, two-way stays linear.
+ */
+static void setup_strstr(struct complexity_ctx* ctx, size_t n) {
+    size_t m = n / 2;
+
+    memset(ctx->input, 'a', n);
+    ctx->input[n] = '\0';
+
+    memset(ctx->pattern, 'a', m - 1);
+    ctx->pattern[m - 1] = 'b';
+    ctx->pattern[m]     = '\0';
+
+    ctx->size        = n;
+    ctx->pattern_len = m;
+}
+
+static void run_strstr(void* arg) {
+    struct complexity_ctx* ctx = arg;
+    bench_keep(strstr(ctx->input, ctx->pattern));
+}
+
+static void run_memmem(void* arg) {
+    struct complexity_ctx* ctx = arg;
+    bench_keep(memmem(ctx->input, ctx->size, ctx->pattern, ctx->pattern_len));
+}
+
+/*
+ * The set is the k bytes from 0xFF down, and the input repeats the one listed last, so a set
+ * searched byte by byte is walked in full for every input byte. A bitmap doesn't care about k.
+ */
+static void setup_accept(struct complexity_ctx* ctx, size_t k) {
+    for (size_t i = 0; i < k; i++)
+        ctx->pattern[i] = 0xFF - i;
+
+    ctx->pattern[k] = '\0';
+
+    memset(ctx->input, 0x100 - k, COMPLEXITY_SET_INPUT);
+    ctx->input[COMPLEXITY_SET_INPUT] = '\0';
+
+    ctx->size        = COMPLEXITY_SET_INPUT;
+    ctx->pattern_len = k;
+}
+
+/* The same set, but the input is made of a byte that isn't in it */
+static void setup_reject(struct complexity_ctx* ctx, size_t k) {
+    setup_accept(ctx, k);
+    memset(ctx->input, 0x01, COMPLEXITY_SET_INPUT);
+}
+
+static void run_strspn(void* arg) {
+    struct complexity_ctx* ctx = arg;
+    bench_keep(strspn(ctx->input, ctx->pattern));
+}
+
+static void run_strcspn(void* arg) {
+    struct complexity_ctx* ctx = arg;
+    bench_keep(strcspn(ctx->input, ctx->pattern));
+}
+
+static void run_strpbrk(void* arg) {
+    struct complexity_ctx* ctx = arg;
+    bench_keep(strpbrk(ctx->input, ctx->pattern));
+}
+
+/* n bytes of short tokens split by runs of delimiters, the tokenizer has to restart after each */
+static void setup_tokens(struct complexity_ctx* ctx, size_t n) {
+    static const char stream[] = "key, value;; 42 ,token;";
+
+    for (size_t i = 0; i < n; i++)
+        ctx->input[i] = stream[i % (sizeof(stream) - 1)];
+
+    ctx->input[n] = '\0';
+
+    strcpy(ctx->pattern, " ,;");
+
+    ctx->size        = n;
+    ctx->pattern_len = 3;
+}
+
+/* strtok() writes into the string, so every call tokenizes a fresh copy */
+static void run_strtok(void* arg) {
+    struct complexity_ctx* ctx   = arg;
+    size_t                 count = 0;
+
+    memcpy(ctx->work, ctx->input, ctx->size + 1);
+
+    for (char* tok = strtok(ctx->work, ctx->pattern); tok; tok = strtok(NULL, ctx->pattern))
+        count++;
+
+    bench_keep(count);
+}
+
+static void run_strtok_r(void* arg) {
+    struct complexity_ctx* ctx   = arg;
+    size_t                 count = 0;
+    char*                  ptr;
+
+    memcpy(ctx->work, ctx->input, ctx->size + 1);
+
+    for (char* tok = strtok_r(ctx->work, ctx->pattern, &ptr); tok; count++)
+        tok = strtok_r(NULL, ctx->pattern, &ptr);
+
+    bench_keep(count);
+}
+
+static const struct complexity_probe complexity_probes[] = {
+    {"complexity.strstr", "needle=n/2", setup_strstr, run_strstr, false, 1},
+    {"complexity.memmem", "needle=n/2", setup_strstr, run_memmem, false, 1},
+    {"complexity.strspn", "input=64K", setup_accept, run_strspn, true, 0},
+    {"complexity.strcspn", "input=64K", setup_reject, run_strcspn, true, 0},
+    {"complexity.strpbrk", "input=64K", setup_reject, run_strpbrk, true, 0},
+    {"complexity.strtok", "delim=3", setup_tokens, run_strtok, false, 1},
+    {"complexity.strtok_r", "delim=3", setup_tokens, run_strtok_r, false, 1},
+};
+
+/* The least squares slope of log(time) over log(n), which is the exponent of the growth */
+static double complexity_fit(const double* n, const double* ns, size_t count) {
+    double mean_x = 0, mean_y = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        mean_x += log(n[i]) / count;
+        mean_y += log(ns[i]) / count;
+    }
+
+    double cov = 0, var = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        double dx = log(n[i]) - mean_x;
+
+        cov += dx * (log(ns[i]) - mean_y);
+        var += dx * dx;
+    }
+
+    return cov / var;
+}
+
+/*
+ * Runs the probe at every point of its axis until one call takes longer than limit_ns, since
+ * the next size up could take minutes on a quadratic implementation. Returns false if the
+ * probe grows steeper than it should.
+ */
+static bool complexity_run(const struct complexity_probe* probe, struct complexity_ctx* ctx,
+                           size_t max_size, uint64_t target_ns, uint64_t limit_ns) {
+    double n[32], ns[32];
+    size_t count   = 0;
+    bool   limited = false;
+    char   params[64];
+
+    for (size_t i = 0; count < sizeof(n) / sizeof(n[0]); i++) {
+        size_t point;
+
+        if (probe->set_axis) {
+            if (i == sizeof(complexity_sets) / sizeof(complexity_sets[0]))
+                break;
+
+            point = complexity_sets[i];
+        }
+        else {
+            point = KiB(4) << (2 * i);
+
+            if (point > max_size)
+                break;
+        }
+
+        probe->setup(ctx, point);
+
+        n[count]  = point;
+        ns[count] = bench_loop(probe->func, ctx, target_ns);
+
+        snprintf(params, sizeof(params), "%s %s=%zu", probe->params,
+                 probe->set_axis ? "set" : "n", point);
+        bench_report(probe->name, params, "ns/call", ns[count]);
+
+        if (ns[count++] > limit_ns) {
+            limited = true;
+            break;
+        }
+    }
+
+    // hitting the limit this early is a verdict of its own
+    if (count < 3) {
+        fprintf(stderr, "utest: %s has %zu points, too few to fit%s\n", probe->name, count,
+                limited ? ", it hit the time limit" : "");
+        return !limited;
+    }
+
+    double exponent = complexity_fit(n, ns, count);
+
+    snprintf(params, sizeof(params), "%s axis=%s", probe->params, probe->set_axis ? "set" : "n");
+    bench_report(probe->name, params, "exponent", exponent);
+
+    if (exponent > probe->expected + COMPLEXITY_SLACK) {
+        fprintf(stderr, "utest: %s grows as %s^%.2f, expected %s^%.0f\n", probe->name,
+                probe->set_axis ? "set" : "n", exponent, probe->set_axis ? "set" : "n",
+                probe->expected);
+        return false;
+    }
+
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench complexity [-p probe] [-s max_size] [-t target_us] "
+                    "[-l limit_ms]\n");
+}
+
+/*
+ * Feeds the string searching and tokenizing functions their worst case inputs at growing sizes
+ * and fits the time against the size. strstr() and memmem() should stay linear on
+ * near-matching needles, the set functions shouldn't care how large the set is and strtok()
+ * should stay linear over a long token stream. Exits with a failure if any of them doesn't.
+ */
+int bench_complexity(int argc, char* argv[]) {
+    const char* only      = NULL;
+    size_t      max_size  = MiB(4);
+    uint64_t    target_ns = 10000000;
+    uint64_t    limit_ns  = 100000000;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "p:s:t:l:")) != -1) {
+        switch (opt) {
+        case 'p':
+            only = optarg;
+            break;
+        case 's':
+            max_size = bench_size(optarg);
+            break;
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'l':
+            limit_ns = strtoull(optarg, NULL, 0) * 1000000;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t buffer = (max_size > COMPLEXITY_SET_INPUT ? max_size : COMPLEXITY_SET_INPUT) + 1;
+
+    struct complexity_ctx ctx = {
+        .input   = bench_map(buffer),
+        .work    = bench_map(buffer),
+        .pattern = bench_map(buffer),
+    };
+
+    bool ok = true;
+
+    for (size_t p = 0; p < sizeof(complexity_probes) / sizeof(complexity_probes[0]); p++) {
+        const struct complexity_probe* probe = &complexity_probes[p];
+
+        // the name without the "complexity." prefix
+        if (only && strcmp(only, strchr(probe->name, '.') + 1) != 0)
+            continue;
+
+        if (!complexity_run(probe, &ctx, max_size, target_ns, limit_ns))
+            ok = false;
+    }
+
+    bench_unmap(ctx.input, buffer);
+    bench_unmap(ctx.work, buffer);
+    bench_unmap(ctx.pattern, buffer);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
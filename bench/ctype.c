@@ -0,0 +1,323 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <ctype.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct ctype_ctx {
+    unsigned char* src;
+    unsigned char* dst;
+    size_t         size;
+    locale_t       locale;
+};
+
+struct ctype_func {
+    const char* name;
+    const char* impl;
+    void (*func)(void* arg);
+};
+
+/*
+ * Every classifier counts the matching bytes of the whole buffer, every case fold writes the
+ * buffer out converted. The "ascii" versions are the open-coded range checks a parser would use
+ * instead, as the floor for what a table lookup can cost.
+ */
+#define CTYPE_CLASSIFY(name)                                                                       \
+    static void classify_##name(void* arg) {                                                       \
+        struct ctype_ctx* ctx   = arg;                                                             \
+        size_t            count = 0;                                                               \
+                                                                                                   \
+        for (size_t i = 0; i < ctx->size; i++)                                                     \
+            count += name(ctx->src[i]) != 0;                                                       \
+                                                                                                   \
+        bench_keep(count);                                                                         \
+    }                                                                                              \
+                                                                                                   \
+    static void classify_##name##_l(void* arg) {                                                   \
+        struct ctype_ctx* ctx   = arg;                                                             \
+        size_t            count = 0;                                                               \
+                                                                                                   \
+        for (size_t i = 0; i < ctx->size; i++)                                                     \
+            count += name##_l(ctx->src[i], ctx->locale) != 0;                                      \
+                                                                                                   \
+        bench_keep(count);                                                                         \
+    }
+
+CTYPE_CLASSIFY(isalpha)
+CTYPE_CLASSIFY(isalnum)
+CTYPE_CLASSIFY(isdigit)
+CTYPE_CLASSIFY(isxdigit)
+CTYPE_CLASSIFY(isspace)
+CTYPE_CLASSIFY(ispunct)
+
+static int ascii_isalpha(int c) {
+    return (unsigned) ((c | 0x20) - 'a') < 26;
+}
+
+static int ascii_isalnum(int c) {
+    return ascii_isalpha(c) || (unsigned) (c - '0') < 10;
+}
+
+static int ascii_isdigit(int c) {
+    return (unsigned) (c - '0') < 10;
+}
+
+static int ascii_isxdigit(int c) {
+    return (unsigned) (c - '0') < 10 || (unsigned) ((c | 0x20) - 'a') < 6;
+}
+
+static int ascii_isspace(int c) {
+    return c == ' ' || (unsigned) (c - '\t') < 5;
+}
+
+static int ascii_ispunct(int c) {
+    return (unsigned) (c - '!') < 94 && !ascii_isalnum(c);
+}
+
+#define CTYPE_CLASSIFY_ASCII(name)                                                                 \
+    static void classify_ascii_##name(void* arg) {                                                 \
+        struct ctype_ctx* ctx   = arg;                                                             \
+        size_t            count = 0;                                                               \
+                                                                                                   \
+        for (size_t i = 0; i < ctx->size; i++)                                                     \
+            count += ascii_##name(ctx->src[i]) != 0;                                               \
+                                                                                                   \
+        bench_keep(count);                                                                         \
+    }
+
+CTYPE_CLASSIFY_ASCII(isalpha)
+CTYPE_CLASSIFY_ASCII(isalnum)
+CTYPE_CLASSIFY_ASCII(isdigit)
+CTYPE_CLASSIFY_ASCII(isxdigit)
+CTYPE_CLASSIFY_ASCII(isspace)
+CTYPE_CLASSIFY_ASCII(ispunct)
+
+static void fold_toupper(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = toupper(ctx->src[i]);
+
+    bench_keep(ctx->dst);
+}
+
+static void fold_toupper_l(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = toupper_l(ctx->src[i], ctx->locale);
+
+    bench_keep(ctx->dst);
+}
+
+/* _toupper() is only defined for lowercase letters, so it needs the check in front of it */
+static void fold__toupper(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = islower(ctx->src[i]) ? _toupper(ctx->src[i]) : ctx->src[i];
+
+    bench_keep(ctx->dst);
+}
+
+static void fold_ascii_toupper(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++) {
+        unsigned char c = ctx->src[i];
+        ctx->dst[i]     = (unsigned) (c - 'a') < 26 ? c - 0x20 : c;
+    }
+
+    bench_keep(ctx->dst);
+}
+
+static void fold_tolower(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = tolower(ctx->src[i]);
+
+    bench_keep(ctx->dst);
+}
+
+static void fold_tolower_l(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = tolower_l(ctx->src[i], ctx->locale);
+
+    bench_keep(ctx->dst);
+}
+
+static void fold__tolower(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++)
+        ctx->dst[i] = isupper(ctx->src[i]) ? _tolower(ctx->src[i]) : ctx->src[i];
+
+    bench_keep(ctx->dst);
+}
+
+static void fold_ascii_tolower(void* arg) {
+    struct ctype_ctx* ctx = arg;
+
+    for (size_t i = 0; i < ctx->size; i++) {
+        unsigned char c = ctx->src[i];
+        ctx->dst[i]     = (unsigned) (c - 'A') < 26 ? c + 0x20 : c;
+    }
+
+    bench_keep(ctx->dst);
+}
+
+#define CTYPE_FUNCS(name)                                                                          \
+    {#name, "libc", classify_##name}, {#name, "_l", classify_##name##_l},                          \
+        {#name, "ascii", classify_ascii_##name}
+
+static const struct ctype_func ctype_funcs[] = {
+    CTYPE_FUNCS(isalpha),
+    CTYPE_FUNCS(isalnum),
+    CTYPE_FUNCS(isdigit),
+    CTYPE_FUNCS(isxdigit),
+    CTYPE_FUNCS(isspace),
+    CTYPE_FUNCS(ispunct),
+    {"toupper", "libc", fold_toupper},
+    {"toupper", "_l", fold_toupper_l},
+    {"toupper", "_toupper", fold__toupper},
+    {"toupper", "ascii", fold_ascii_toupper},
+    {"tolower", "libc", fold_tolower},
+    {"tolower", "_l", fold_tolower_l},
+    {"tolower", "_tolower", fold__tolower},
+    {"tolower", "ascii", fold_ascii_tolower},
+};
+
+/* The locales the _l variants get, only the ones this system has are run */
+static const char* const ctype_locales[] = {"C", "C.UTF-8", "en_US.UTF-8"};
+
+/*
+ * Mostly text, the way a parser sees it: letters, digits, spaces and punctuation, with one byte
+ * in 16 from the upper half so the non-ASCII entries of the tables get read too.
+ */
+static void ctype_fill(unsigned char* buffer, size_t size) {
+    static const char text[] = "The quick brown fox, 42 lazy DOGS; jumps_over\t{0x1F}\n";
+    uint64_t          state  = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        if (state % 16 == 0)
+            buffer[i] = 0x80 | (state >> 8);
+        else
+            buffer[i] = text[(state >> 8) % (sizeof(text) - 1)];
+    }
+}
+
+static void ctype_run(const struct ctype_func* func, struct ctype_ctx* ctx, const char* locale,
+                      uint64_t target_ns) {
+    double ns = bench_loop(func->func, ctx, target_ns);
+
+    char name[32];
+    char params[64];
+
+    snprintf(name, sizeof(name), "ctype.%s", func->name);
+
+    if (locale)
+        snprintf(params, sizeof(params), "impl=%s locale=%s size=%zu", func->impl, locale,
+                 ctx->size);
+    else
+        snprintf(params, sizeof(params), "impl=%s size=%zu", func->impl, ctx->size);
+
+    bench_report(name, params, "MB/s", ctx->size / ns * 1000);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench ctype [-f function] [-s size] [-t target_us]\n");
+}
+
+/*
+ * Classification and case folding throughput over a buffer of text, through the plain functions
+ * in the global C locale, the _l variants with explicit locale objects, _toupper()/_tolower()
+ * and open-coded ASCII checks. The gap between them is what the locale indirection costs.
+ */
+int bench_ctype(int argc, char* argv[]) {
+    const char* only      = NULL;
+    size_t      size      = MiB(4);
+    uint64_t    target_ns = 100000000;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "f:s:t:")) != -1) {
+        switch (opt) {
+        case 'f':
+            only = optarg;
+            break;
+        case 's':
+            size = bench_size(optarg);
+            break;
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (size == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct ctype_ctx ctx = {
+        .src  = bench_map(size),
+        .dst  = bench_map(size),
+        .size = size,
+    };
+
+    ctype_fill(ctx.src, size);
+    memset(ctx.dst, 0, size);
+
+    locale_t locales[sizeof(ctype_locales) / sizeof(ctype_locales[0])];
+
+    for (size_t l = 0; l < sizeof(ctype_locales) / sizeof(ctype_locales[0]); l++) {
+        locales[l] = newlocale(LC_CTYPE_MASK, ctype_locales[l], (locale_t) 0);
+
+        if (!locales[l])
+            fprintf(stderr, "utest: no %s locale, skipping it\n", ctype_locales[l]);
+    }
+
+    for (size_t f = 0; f < sizeof(ctype_funcs) / sizeof(ctype_funcs[0]); f++) {
+        const struct ctype_func* func = &ctype_funcs[f];
+
+        if (only && strcmp(only, func->name) != 0)
+            continue;
+
+        if (strcmp(func->impl, "_l") != 0) {
+            ctype_run(func, &ctx, NULL, target_ns);
+            continue;
+        }
+
+        for (size_t l = 0; l < sizeof(ctype_locales) / sizeof(ctype_locales[0]); l++) {
+            if (!locales[l])
+                continue;
+
+            ctx.locale = locales[l];
+            ctype_run(func, &ctx, ctype_locales[l], target_ns);
+        }
+    }
+
+    for (size_t l = 0; l < sizeof(ctype_locales) / sizeof(ctype_locales[0]); l++)
+        if (locales[l])
+            freelocale(locales[l]);
+
+    bench_unmap(ctx.src, size);
+    bench_unmap(ctx.dst, size);
+
+    return EXIT_SUCCESS;
+}
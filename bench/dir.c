@@ -0,0 +1,343 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Leaf directories are spread over this many middle directories */
+#define DIR_FANOUT 32
+
+/* Levels of directories in the tree: the root, the middle directories and the leaves */
+#define DIR_DEPTH 3
+
+enum dir_walk {
+    WALK_READDIR,
+    WALK_FSTATAT,
+#ifdef STATX_BASIC_STATS
+    WALK_STATX,
+#endif
+};
+
+static const char* const dir_walk_names[] = {
+    "readdir",
+    "readdir+fstatat",
+#ifdef STATX_BASIC_STATS
+    "readdir+statx",
+#endif
+};
+
+#ifdef __linux__
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+static const size_t dir_getdents_sizes[] = {KiB(4), KiB(64), MiB(1)};
+#endif
+
+static bool dir_dots(const char* name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+static int dir_open(int parent, const char* name) {
+    int fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    ASSERT(fd != -1);
+
+    return fd;
+}
+
+/* Lays files out as root/m<leaf / DIR_FANOUT>/l<leaf>/f<file>, every leaf holding per_dir files */
+static void dir_build(int root, size_t files, size_t per_dir) {
+    char name[64];
+
+    for (size_t leaf = 0; leaf * per_dir < files; leaf++) {
+        snprintf(name, sizeof(name), "m%zu", leaf / DIR_FANOUT);
+
+        if (leaf % DIR_FANOUT == 0)
+            ASSERT(mkdirat(root, name, 0755) == 0);
+
+        int middle = dir_open(root, name);
+
+        snprintf(name, sizeof(name), "l%zu", leaf);
+        ASSERT(mkdirat(middle, name, 0755) == 0);
+
+        int dir = dir_open(middle, name);
+
+        for (size_t i = 0; i < per_dir && leaf * per_dir + i < files; i++) {
+            snprintf(name, sizeof(name), "f%zu", i);
+
+            int fd = openat(dir, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            ASSERT(fd != -1);
+            close(fd);
+        }
+
+        close(dir);
+        close(middle);
+    }
+}
+
+/* Walks everything below fd relative to the open directory and closes fd. Returns the entries. */
+static size_t dir_walk(int fd, enum dir_walk walk) {
+    DIR*           dir   = fdopendir(fd);
+    size_t         count = 0;
+    struct dirent* entry;
+
+    ASSERT(dir);
+
+    while ((entry = readdir(dir))) {
+        if (dir_dots(entry->d_name))
+            continue;
+
+        bool is_dir = entry->d_type == DT_DIR;
+        count++;
+
+        if (walk == WALK_FSTATAT || entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+
+            ASSERT(fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0);
+            is_dir = S_ISDIR(st.st_mode);
+        }
+#ifdef STATX_BASIC_STATS
+        else if (walk == WALK_STATX) {
+            struct statx stx;
+
+            ASSERT(statx(dirfd(dir), entry->d_name, AT_SYMLINK_NOFOLLOW,
+                         STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &stx) == 0);
+            is_dir = S_ISDIR(stx.stx_mode);
+        }
+#endif
+
+        if (is_dir)
+            count += dir_walk(dir_open(dirfd(dir), entry->d_name), walk);
+    }
+
+    closedir(dir);
+    return count;
+}
+
+/* The same walk, but every directory is opened and every entry stat()ed by its full path */
+static size_t dir_walk_path(char* path, size_t len) {
+    DIR*           dir   = opendir(path);
+    size_t         count = 0;
+    struct dirent* entry;
+
+    ASSERT(dir);
+
+    while ((entry = readdir(dir))) {
+        if (dir_dots(entry->d_name))
+            continue;
+
+        int         end = snprintf(path + len, PATH_MAX - len, "/%s", entry->d_name);
+        struct stat st;
+
+        ASSERT(stat(path, &st) == 0);
+        count++;
+
+        if (S_ISDIR(st.st_mode))
+            count += dir_walk_path(path, len + end);
+    }
+
+    path[len] = '\0';
+    closedir(dir);
+
+    return count;
+}
+
+/* Whether a directory entry is a directory, asking the filesystem if readdir() doesn't know */
+static bool dir_is_dir(int parent, const char* name, unsigned char type) {
+    struct stat st;
+
+    if (type != DT_UNKNOWN)
+        return type == DT_DIR;
+
+    ASSERT(fstatat(parent, name, &st, AT_SYMLINK_NOFOLLOW) == 0);
+    return S_ISDIR(st.st_mode);
+}
+
+#ifdef __linux__
+/*
+ * buffers holds one buffer of size bytes for each of the depth levels left, every level needs
+ * one of its own as the parent's is still being walked
+ */
+static size_t dir_walk_getdents(int fd, char* buffers, size_t size, size_t depth) {
+    size_t  count = 0;
+    ssize_t len;
+
+    while ((len = syscall(SYS_getdents64, fd, buffers, size)) > 0) {
+        for (ssize_t off = 0; off < len;) {
+            struct linux_dirent64* entry = (struct linux_dirent64*) (buffers + off);
+
+            off += entry->d_reclen;
+
+            if (dir_dots(entry->d_name))
+                continue;
+
+            count++;
+
+            if (dir_is_dir(fd, entry->d_name, entry->d_type)) {
+                ASSERT(depth > 1);
+                count += dir_walk_getdents(dir_open(fd, entry->d_name), buffers + size, size,
+                                           depth - 1);
+            }
+        }
+    }
+
+    ASSERT(len == 0);
+    close(fd);
+
+    return count;
+}
+#endif
+
+static size_t dir_remove(int fd) {
+    DIR*           dir   = fdopendir(fd);
+    size_t         count = 0;
+    struct dirent* entry;
+
+    ASSERT(dir);
+
+    while ((entry = readdir(dir))) {
+        if (dir_dots(entry->d_name))
+            continue;
+
+        if (dir_is_dir(dirfd(dir), entry->d_name, entry->d_type)) {
+            count += dir_remove(dir_open(dirfd(dir), entry->d_name));
+            ASSERT(unlinkat(dirfd(dir), entry->d_name, AT_REMOVEDIR) == 0);
+        }
+        else
+            ASSERT(unlinkat(dirfd(dir), entry->d_name, 0) == 0);
+
+        count++;
+    }
+
+    closedir(dir);
+    return count;
+}
+
+static void dir_report(const char* name, const char* params, size_t entries, uint64_t start,
+                       size_t expected) {
+    uint64_t elapsed = bench_now() - start;
+
+    ASSERT(entries == expected);
+    bench_report(name, params, "entries/s", entries * 1e9 / elapsed);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench dir [-d directory] [-n files] [-e files_per_dir]\n");
+}
+
+/*
+ * Builds a synthetic tree and crawls it every way an indexer might: readdir() alone, with a
+ * stat per entry relative to the open directory, with absolute paths, and with raw getdents64
+ * at several buffer sizes. The tree is fresh in the dentry and inode caches for every walk.
+ */
+int bench_dir(int argc, char* argv[]) {
+    const char* parent  = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    size_t      files   = 100000;
+    size_t      per_dir = 100;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "d:n:e:")) != -1) {
+        switch (opt) {
+        case 'd':
+            parent = optarg;
+            break;
+        case 'n':
+            files = strtoull(optarg, NULL, 0);
+            break;
+        case 'e':
+            per_dir = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (files == 0 || per_dir == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/utest-dir-XXXXXX", parent);
+
+    if (!mkdtemp(path)) {
+        fprintf(stderr, "utest: %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    size_t leaves  = (files + per_dir - 1) / per_dir;
+    size_t entries = files + leaves + (leaves + DIR_FANOUT - 1) / DIR_FANOUT;
+    int    root    = dir_open(AT_FDCWD, path);
+
+    char params[64];
+    snprintf(params, sizeof(params), "files=%zu per_dir=%zu", files, per_dir);
+
+    uint64_t start = bench_now();
+    dir_build(root, files, per_dir);
+    dir_report("dir.create", params, entries, start, entries);
+
+    for (size_t w = 0; w < sizeof(dir_walk_names) / sizeof(dir_walk_names[0]); w++) {
+        snprintf(params, sizeof(params), "walk=%s files=%zu", dir_walk_names[w], files);
+
+        start        = bench_now();
+        size_t count = dir_walk(dir_open(root, "."), w);
+
+        dir_report("dir.walk", params, count, start, entries);
+    }
+
+    snprintf(params, sizeof(params), "walk=readdir+stat path=absolute files=%zu", files);
+
+    start        = bench_now();
+    size_t count = dir_walk_path(path, strlen(path));
+
+    dir_report("dir.walk", params, count, start, entries);
+
+#ifdef __linux__
+    for (size_t s = 0; s < sizeof(dir_getdents_sizes) / sizeof(dir_getdents_sizes[0]); s++) {
+        size_t size    = dir_getdents_sizes[s];
+        char*  buffers = malloc(size * DIR_DEPTH);
+        ASSERT(buffers);
+
+        // faulted in up front, so the first directory of every level doesn't pay for it
+        memset(buffers, 0, size * DIR_DEPTH);
+
+        snprintf(params, sizeof(params), "walk=getdents64 buffer=%zu files=%zu", size, files);
+
+        start = bench_now();
+        count = dir_walk_getdents(dir_open(root, "."), buffers, size, DIR_DEPTH);
+
+        dir_report("dir.walk", params, count, start, entries);
+
+        free(buffers);
+    }
+#endif
+
+    snprintf(params, sizeof(params), "files=%zu per_dir=%zu", files, per_dir);
+
+    start = bench_now();
+    count = dir_remove(root);
+
+    dir_report("dir.remove", params, count, start, entries);
+
+    ASSERT(rmdir(path) == 0);
+    return EXIT_SUCCESS;
+}
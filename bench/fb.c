@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <linux/fb.h>
+#endif
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The layout the kiosk framebuffers use, also used for the stand-in when there's no device */
+#define FB_STRIDE 1280
+#define FB_WIDTH  1280
+#define FB_HEIGHT 720
+
+#define FB_RECTS 64
+
+/* rect() wraps into the top left 512x512 pixels of a 1280 pixel stride, whatever the device */
+#define FB_RECT_SPAN ((size_t) 511 * 1280 + 512)
+
+typedef uint32_t fb_vec __attribute__((vector_size(16)));
+
+struct fb {
+    uint32_t* pixels;
+    size_t    size;
+    uint32_t  stride; // in pixels
+    uint32_t  width;
+    uint32_t  height;
+    bool      device;
+};
+
+struct fb_rect {
+    uint32_t x;
+    uint32_t y;
+};
+
+struct fb_ctx {
+    struct fb*     fb;
+    struct fb_rect rects[FB_RECTS];
+    uint32_t       size;
+    uint32_t*      sprite;
+    size_t         rect;
+    uint32_t       color;
+};
+
+void rect(uint32_t* fb, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t rgb);
+
+/* test_fb()'s own rect(), wrapping every coordinate and storing one pixel at a time */
+static void fill_pixel(void* arg) {
+    struct fb_ctx*  ctx = arg;
+    struct fb_rect* r   = &ctx->rects[ctx->rect++ % FB_RECTS];
+
+    rect(ctx->fb->pixels, r->x, r->y, ctx->size, ctx->size, ctx->color);
+}
+
+/* Rects are placed so they never need clipping, which leaves a plain store loop per row */
+static void fill_row(void* arg) {
+    struct fb_ctx*  ctx  = arg;
+    struct fb*      fb   = ctx->fb;
+    struct fb_rect* rect = &ctx->rects[ctx->rect++ % FB_RECTS];
+    uint32_t*       row  = fb->pixels + rect->y * fb->stride + rect->x;
+
+    for (uint32_t j = 0; j < ctx->size; j++, row += fb->stride)
+        for (uint32_t i = 0; i < ctx->size; i++)
+            row[i] = ctx->color;
+}
+
+/* Only works for colors made of four identical bytes, but gives the ceiling for the rest */
+static void fill_memset(void* arg) {
+    struct fb_ctx*  ctx  = arg;
+    struct fb*      fb   = ctx->fb;
+    struct fb_rect* rect = &ctx->rects[ctx->rect++ % FB_RECTS];
+    uint32_t*       row  = fb->pixels + rect->y * fb->stride + rect->x;
+
+    for (uint32_t j = 0; j < ctx->size; j++, row += fb->stride)
+        memset(row, ctx->color & 0xff, ctx->size * sizeof(uint32_t));
+}
+
+/* Scalar stores up to 16 byte alignment, then whole vectors of the pattern, then the tail */
+static void fill_vector(void* arg) {
+    struct fb_ctx*  ctx     = arg;
+    struct fb*      fb      = ctx->fb;
+    struct fb_rect* rect    = &ctx->rects[ctx->rect++ % FB_RECTS];
+    uint32_t*       row     = fb->pixels + rect->y * fb->stride + rect->x;
+    fb_vec          pattern = {ctx->color, ctx->color, ctx->color, ctx->color};
+
+    for (uint32_t j = 0; j < ctx->size; j++, row += fb->stride) {
+        uint32_t* ptr = row;
+        uint32_t* end = row + ctx->size;
+
+        while (ptr < end && ((uintptr_t) ptr & (sizeof(fb_vec) - 1)))
+            *ptr++ = ctx->color;
+
+        for (; end - ptr >= 4; ptr += 4)
+            *(fb_vec*) ptr = pattern;
+
+        while (ptr < end)
+            *ptr++ = ctx->color;
+    }
+}
+
+static void blit_memcpy(void* arg) {
+    struct fb_ctx*  ctx    = arg;
+    struct fb*      fb     = ctx->fb;
+    struct fb_rect* rect   = &ctx->rects[ctx->rect++ % FB_RECTS];
+    uint32_t*       row    = fb->pixels + rect->y * fb->stride + rect->x;
+    uint32_t*       sprite = ctx->sprite;
+
+    for (uint32_t j = 0; j < ctx->size; j++, row += fb->stride, sprite += ctx->size)
+        memcpy(row, sprite, ctx->size * sizeof(uint32_t));
+}
+
+struct fb_method {
+    const char* name;
+    void (*func)(void* arg);
+};
+
+static const struct fb_method fb_methods[] = {
+    {"pixel", fill_pixel},
+    {"row", fill_row},
+    {"memset", fill_memset},
+    {"vector", fill_vector},
+    {"blit", blit_memcpy},
+};
+
+static const uint32_t fb_sizes[] = {8, 32, 128, 512};
+
+/*
+ * Maps the real framebuffer if there is a 32 bpp one, or a memfd of the same layout otherwise.
+ * The memfd is still a shared file mapping, so stores go through the same page cache path.
+ */
+static void fb_open(struct fb* fb, const char* path, bool standin) {
+    int fd = -1;
+
+    memset(fb, 0, sizeof(*fb));
+
+#ifdef __linux__
+    if (!standin && (fd = open(path, O_RDWR)) != -1) {
+        struct fb_var_screeninfo var;
+        struct fb_fix_screeninfo fix;
+
+        if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == 0 &&
+            ioctl(fd, FBIOGET_FSCREENINFO, &fix) == 0 && var.bits_per_pixel == 32) {
+            fb->stride = fix.line_length / sizeof(uint32_t);
+            fb->width  = var.xres;
+            fb->height = var.yres;
+            fb->size   = fix.smem_len;
+            fb->device = true;
+        }
+        else {
+            fprintf(stderr, "utest: %s isn't a 32 bpp framebuffer, using a stand-in\n", path);
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd == -1) {
+        fd = memfd_create("utest-fb", MFD_CLOEXEC);
+        ASSERT(fd != -1);
+
+        fb->stride = FB_STRIDE;
+        fb->width  = FB_WIDTH;
+        fb->height = FB_HEIGHT;
+        fb->size   = (size_t) FB_STRIDE * FB_HEIGHT * sizeof(uint32_t);
+
+        ASSERT(ftruncate(fd, fb->size) == 0);
+    }
+#else
+    fd = open(path, O_RDWR);
+    ASSERT(fd != -1);
+
+    fb->stride = FB_STRIDE;
+    fb->width  = FB_WIDTH;
+    fb->height = FB_HEIGHT;
+    fb->size   = (size_t) FB_STRIDE * FB_HEIGHT * sizeof(uint32_t);
+    fb->device = true;
+#endif
+
+    fb->pixels = mmap(NULL, fb->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(fb->pixels != MAP_FAILED);
+
+    close(fd);
+
+    // fault everything in up front so the first method doesn't pay for it
+    memset(fb->pixels, 0, fb->size);
+}
+
+static void fb_run(struct fb_ctx* ctx, const struct fb_method* method, uint64_t target_ns) {
+    struct fb* fb = ctx->fb;
+    char       params[64];
+
+    // every method draws the same rects, so the pixel path is compared like for like
+    srand(ctx->size);
+
+    for (size_t i = 0; i < FB_RECTS; i++) {
+        ctx->rects[i].x = rand() % (fb->width - ctx->size + 1);
+        ctx->rects[i].y = rand() % (fb->height - ctx->size + 1);
+    }
+
+    ctx->rect  = 0;
+    ctx->color = method->func == fill_memset ? 0x7f7f7f7f : 0x59c4dd;
+
+    double ns = bench_loop(method->func, ctx, target_ns);
+
+    snprintf(params, sizeof(params), "method=%s rect=%ux%u fb=%s", method->name, ctx->size,
+             ctx->size, fb->device ? "device" : "memfd");
+
+    bench_report("fb.fill", params, "Mpixel/s", (double) ctx->size * ctx->size / ns * 1000);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench fb [-d device] [-m] [-t target_us]\n");
+}
+
+/*
+ * Fill rate of square rects and sprite blits into the framebuffer mapping, from the per-pixel
+ * path test_fb() uses up to whole-row memset, vector and memcpy stores.
+ */
+int bench_fb(int argc, char* argv[]) {
+    const char* path      = "/dev/fb0";
+    bool        standin   = false;
+    uint64_t    target_ns = 20000000;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "d:mt:")) != -1) {
+        switch (opt) {
+        case 'd':
+            path = optarg;
+            break;
+        case 'm':
+            standin = true;
+            break;
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct fb     fb;
+    struct fb_ctx ctx = {.fb = &fb};
+
+    fb_open(&fb, path, standin);
+
+    if (fb.size < FB_RECT_SPAN * sizeof(uint32_t))
+        fprintf(stderr, "utest: the framebuffer is too small for rect(), skipping method=pixel\n");
+
+    size_t max_size = fb_sizes[sizeof(fb_sizes) / sizeof(fb_sizes[0]) - 1];
+
+    ctx.sprite = malloc(max_size * max_size * sizeof(uint32_t));
+    ASSERT(ctx.sprite);
+
+    for (size_t i = 0; i < max_size * max_size; i++)
+        ctx.sprite[i] = i * 0x010203;
+
+    for (size_t s = 0; s < sizeof(fb_sizes) / sizeof(fb_sizes[0]); s++) {
+        ctx.size = fb_sizes[s];
+
+        if (ctx.size > fb.width || ctx.size > fb.height)
+            continue;
+
+        for (size_t m = 0; m < sizeof(fb_methods) / sizeof(fb_methods[0]); m++) {
+            // rect() would store past the end of a device smaller than what it assumes
+            if (fb_methods[m].func == fill_pixel && fb.size < FB_RECT_SPAN * sizeof(uint32_t))
+                continue;
+
+            fb_run(&ctx, &fb_methods[m], target_ns);
+        }
+    }
+
+    free(ctx.sprite);
+    munmap(fb.pixels, fb.size);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,370 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Descriptors the process needs besides the ones the benchmark fills the table with */
+#define FD_SPARE 64
+
+/* Allocations below this are too few per bucket to say anything */
+#define FD_MIN_BUCKET 6
+
+extern char** environ;
+
+struct fd_worker {
+    pthread_t thread;
+    uint64_t  ops;
+} __attribute__((aligned(64)));
+
+struct fd_op {
+    const char* name;
+    void (*func)(void* arg);
+};
+
+static char* const fd_exec_argv[3] = {
+    "utest",
+    "exit",
+    NULL,
+};
+
+static const size_t fd_exec_fills[] = {0, 1000, 10000, 100000, 1000000};
+
+static const struct fd_op* fd_current;
+
+static int               fd_base;
+static int               fd_target;
+static volatile int      fd_stopping;
+static pthread_barrier_t fd_start;
+
+static void op_dup(void* arg) {
+    int fd = fcntl(fd_base, F_DUPFD_CLOEXEC, 0);
+
+    ASSERT(fd != -1);
+    close(fd);
+}
+
+static void op_open(void* arg) {
+    int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    ASSERT(fd != -1);
+    close(fd);
+}
+
+/* Closes fd_target and expects the lowest free descriptor to be the same one again */
+static void op_reuse(void* arg) {
+    close(fd_target);
+    ASSERT(fcntl(fd_base, F_DUPFD_CLOEXEC, 0) == fd_target);
+}
+
+/* Replacing a descriptor that's open, which closes the old file first */
+static void op_dup2(void* arg) {
+    ASSERT(dup2(fd_base, fd_target) == fd_target);
+}
+
+static const struct fd_op fd_ops[] = {
+    {"dup", op_dup},
+    {"open", op_open},
+};
+
+static void* fd_thread(void* arg) {
+    struct fd_worker* worker = arg;
+
+    pthread_barrier_wait(&fd_start);
+
+    while (!fd_stopping) {
+        fd_current->func(NULL);
+        worker->ops++;
+    }
+
+    return NULL;
+}
+
+/* Every thread allocates and frees descriptors in the one table the process shares */
+static void fd_contention(const struct fd_op* op, size_t threads, uint64_t duration) {
+    struct fd_worker* workers = aligned_alloc(64, threads * sizeof(struct fd_worker));
+    ASSERT(workers);
+
+    fd_current  = op;
+    fd_stopping = 0;
+
+    ASSERT(pthread_barrier_init(&fd_start, NULL, threads + 1) == 0);
+
+    for (size_t i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        ASSERT(pthread_create(&workers[i].thread, NULL, fd_thread, &workers[i]) == 0);
+    }
+
+    pthread_barrier_wait(&fd_start);
+
+    uint64_t        start = bench_now();
+    struct timespec ts    = {duration / NSEC_PER_SEC, duration % NSEC_PER_SEC};
+
+    nanosleep(&ts, NULL);
+    fd_stopping = 1;
+
+    uint64_t ops = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        ASSERT(pthread_join(workers[i].thread, NULL) == 0);
+        ops += workers[i].ops;
+    }
+
+    uint64_t elapsed = bench_now() - start;
+
+    char params[64];
+    snprintf(params, sizeof(params), "op=%s threads=%zu", op->name, threads);
+
+    bench_report("fd.contention", params, "ops/s", ops * 1e9 / elapsed);
+
+    pthread_barrier_destroy(&fd_start);
+    free(workers);
+}
+
+/*
+ * posix_spawn() copies the whole table into the child, and the exec then has to close every
+ * FD_CLOEXEC descriptor in it. The spawned instances print their banner, so stdout goes to
+ * /dev/null meanwhile.
+ */
+static void fd_exec(size_t fill, size_t iterations, uint64_t* times) {
+    fflush(stdout);
+
+    int null      = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    int stdout_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+
+    ASSERT(null != -1);
+    ASSERT(stdout_fd != -1);
+    ASSERT(dup2(null, STDOUT_FILENO) != -1);
+
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now();
+        pid_t    pid;
+        int      stat;
+
+        ASSERT(posix_spawn(&pid, "utest", NULL, NULL, fd_exec_argv, environ) == 0);
+        ASSERT(waitpid(pid, &stat, 0) == pid);
+
+        times[i] = bench_now() - start;
+
+        ASSERT(WIFEXITED(stat) && WEXITSTATUS(stat) == 0);
+    }
+
+    ASSERT(dup2(stdout_fd, STDOUT_FILENO) != -1);
+
+    close(null);
+    close(stdout_fd);
+
+    char params[64];
+    snprintf(params, sizeof(params), "cloexec=%zu", fill);
+
+    bench_report_dist("fd.exec", params, times, iterations);
+}
+
+/* Allocations are bucketed by the descriptor they returned, a power of two range at a time */
+static void fd_report_bucket(int bucket, double sum, uint64_t count, uint64_t max) {
+    char params[64];
+    snprintf(params, sizeof(params), "fd=%llu-%llu", 1ULL << bucket, (2ULL << bucket) - 1);
+
+    bench_report("fd.alloc", params, "ns (mean)", sum / count);
+    bench_report("fd.alloc", params, "ns (max)", max);
+}
+
+/* Per descriptor cost of close() on every fd in [first, last], one at a time from the top */
+static void fd_close_loop(int first, int last) {
+    char     params[64];
+    uint64_t start = bench_now();
+
+    for (int fd = last; fd >= first; fd--)
+        close(fd);
+
+    uint64_t elapsed = bench_now() - start;
+
+    snprintf(params, sizeof(params), "method=close count=%d", last - first + 1);
+    bench_report("fd.close", params, "ns/fd", (double) elapsed / (last - first + 1));
+}
+
+#ifdef CLOSE_RANGE_CLOEXEC
+static void fd_close_range(int first, int last, unsigned flags) {
+    char     params[64];
+    uint64_t start = bench_now();
+
+    ASSERT(close_range(first, last, flags) == 0);
+
+    uint64_t elapsed = bench_now() - start;
+
+    snprintf(params, sizeof(params), "method=%s count=%d",
+             flags & CLOSE_RANGE_CLOEXEC ? "close_range_cloexec" : "close_range",
+             last - first + 1);
+    bench_report("fd.close", params, "ns/fd", (double) elapsed / (last - first + 1));
+}
+#endif
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench fd [-n max_fds] [-i exec_iterations] [-d duration_ms] "
+                    "[-t max_threads]\n");
+}
+
+/*
+ * Grows the descriptor table one lowest-free allocation at a time up to max_fds, with the mean
+ * and worst allocation per power of two showing where the table had to be expanded. Spawning
+ * is timed at several fills along the way. With the table full, reusing a hole and dup2() onto
+ * an open descriptor are timed at the bottom, middle and top, and the table is emptied again
+ * with close() and close_range(). Contention between threads on one table runs first, while
+ * it's still small.
+ */
+int bench_fd(int argc, char* argv[]) {
+    size_t   max_fds     = 1000000;
+    size_t   iterations  = 20;
+    uint64_t duration    = 100 * 1000000ULL;
+    size_t   max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "n:i:d:t:")) != -1) {
+        switch (opt) {
+        case 'n':
+            max_fds = strtoull(optarg, NULL, 0);
+            break;
+        case 'i':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 'd':
+            duration = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (iterations == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (access("utest", X_OK) != 0) {
+        fprintf(stderr, "utest: bench fd must be run from the directory containing utest\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t room = bench_nofile(max_fds + FD_SPARE);
+
+    if (room <= FD_SPARE) {
+        fprintf(stderr, "utest: RLIMIT_NOFILE only leaves room for %zu descriptors, %i are needed "
+                        "besides the table\n",
+                room, FD_SPARE);
+        return EXIT_FAILURE;
+    }
+
+    if (room < max_fds + FD_SPARE) {
+        max_fds = room - FD_SPARE;
+        fprintf(stderr, "utest: RLIMIT_NOFILE only leaves room for %zu descriptors\n", max_fds);
+    }
+
+    fd_base = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    ASSERT(fd_base != -1);
+
+    for (size_t o = 0; o < sizeof(fd_ops) / sizeof(fd_ops[0]); o++)
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            fd_contention(&fd_ops[o], threads, duration);
+
+            // always finish with every CPU busy, even if it isn't a power of two
+            if (threads < max_threads && threads * 2 > max_threads)
+                fd_contention(&fd_ops[o], max_threads, duration);
+        }
+
+    uint64_t* times = malloc(iterations * sizeof(uint64_t));
+    ASSERT(times);
+
+    size_t   exec   = 0;
+    int      first  = -1;
+    int      last   = -1;
+    int      bucket = -1;
+    double   sum    = 0;
+    uint64_t count  = 0;
+    uint64_t max    = 0;
+
+    for (size_t filled = 0; filled < max_fds; filled++) {
+        if (exec < sizeof(fd_exec_fills) / sizeof(fd_exec_fills[0]) &&
+            fd_exec_fills[exec] == filled)
+            fd_exec(fd_exec_fills[exec++], iterations, times);
+
+        uint64_t start   = bench_now();
+        int      fd      = fcntl(fd_base, F_DUPFD_CLOEXEC, 0);
+        uint64_t elapsed = bench_now() - start;
+
+        ASSERT(fd != -1);
+
+        first = first == -1 ? fd : first;
+        last  = fd;
+
+        int b = 63 - __builtin_clzll(fd | 1);
+
+        if (b != bucket) {
+            if (bucket >= FD_MIN_BUCKET)
+                fd_report_bucket(bucket, sum, count, max);
+
+            bucket = b;
+            sum    = 0;
+            count  = 0;
+            max    = 0;
+        }
+
+        sum += elapsed;
+        count++;
+        max = elapsed > max ? elapsed : max;
+    }
+
+    if (bucket >= FD_MIN_BUCKET)
+        fd_report_bucket(bucket, sum, count, max);
+
+    if (exec < sizeof(fd_exec_fills) / sizeof(fd_exec_fills[0]) &&
+        fd_exec_fills[exec] == max_fds)
+        fd_exec(max_fds, iterations, times);
+
+    // a full table, the lowest free descriptor is always the hole just made
+    const int         targets[] = {first, first + (last - first) / 2, last};
+    const char* const names[]   = {"bottom", "middle", "top"};
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]) && last > first; t++) {
+        char params[64];
+
+        fd_target = targets[t];
+        snprintf(params, sizeof(params), "hole=%s fd=%d", names[t], fd_target);
+
+        bench_report("fd.reuse", params, "ns/call", bench_loop(op_reuse, NULL, 10000000));
+        bench_report("fd.dup2", params, "ns/call", bench_loop(op_dup2, NULL, 10000000));
+    }
+
+    if (last > first) {
+        int middle = first + (last - first) / 2;
+
+#ifdef CLOSE_RANGE_CLOEXEC
+        fd_close_range(first, last, CLOSE_RANGE_CLOEXEC);
+#endif
+        fd_close_loop(middle + 1, last);
+
+#ifdef CLOSE_RANGE_CLOEXEC
+        fd_close_range(first, middle, 0);
+#else
+        fd_close_loop(first, middle);
+#endif
+    }
+
+    close(fd_base);
+    free(times);
+
+    return EXIT_SUCCESS;
+}
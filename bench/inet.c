@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <endian.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define INET_ADDRS 256
+
+struct inet_ctx {
+    void*  src;
+    void*  dst;
+    size_t count;
+};
+
+struct inet_swap {
+    const char* impl;
+    int         width;
+    void (*func)(void* arg);
+};
+
+struct inet_conversion {
+    const char* name;
+    const char* params;
+    void (*func)(void* arg);
+};
+
+struct inet_lookup {
+    const char* name;
+    const char* host;
+    const char* family_name;
+    int         family;
+    int         flags;
+};
+
+/*
+ * The exported functions, called through a pointer the compiler can't see through, so every
+ * element pays for a real call the way it would if the headers didn't inline them.
+ */
+static uint16_t (*volatile inet_htons)(uint16_t) = (htons);
+static uint32_t (*volatile inet_htonl)(uint32_t) = (htonl);
+
+static char            inet_v4_text[INET_ADDRS][INET_ADDRSTRLEN];
+static char            inet_v6_text[INET_ADDRS][INET6_ADDRSTRLEN];
+static struct in_addr  inet_v4[INET_ADDRS];
+static struct in6_addr inet_v6[INET_ADDRS];
+
+static void swap16_inline(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint16_t*  src = ctx->src;
+    uint16_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = htons(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap16_call(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint16_t*  src = ctx->src;
+    uint16_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = inet_htons(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap16_builtin(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint16_t*  src = ctx->src;
+    uint16_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = __builtin_bswap16(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap32_inline(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint32_t*  src = ctx->src;
+    uint32_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = htonl(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap32_call(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint32_t*  src = ctx->src;
+    uint32_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = inet_htonl(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap32_builtin(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint32_t*  src = ctx->src;
+    uint32_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = __builtin_bswap32(src[i]);
+
+    bench_keep(dst);
+}
+
+/* There's no exported 64-bit function to call, htobe64() only exists as a macro */
+static void swap64_inline(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint64_t*  src = ctx->src;
+    uint64_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = htobe64(src[i]);
+
+    bench_keep(dst);
+}
+
+static void swap64_builtin(void* arg) {
+    struct inet_ctx* ctx = arg;
+    const uint64_t*  src = ctx->src;
+    uint64_t*        dst = ctx->dst;
+
+    for (size_t i = 0; i < ctx->count; i++)
+        dst[i] = __builtin_bswap64(src[i]);
+
+    bench_keep(dst);
+}
+
+static const struct inet_swap inet_swaps[] = {
+    {"htons", 16, swap16_inline},
+    {"htons_call", 16, swap16_call},
+    {"builtin", 16, swap16_builtin},
+    {"htonl", 32, swap32_inline},
+    {"htonl_call", 32, swap32_call},
+    {"builtin", 32, swap32_builtin},
+    {"htobe64", 64, swap64_inline},
+    {"builtin", 64, swap64_builtin},
+};
+
+static void run_pton4(void* arg) {
+    struct in_addr addr;
+
+    for (size_t i = 0; i < INET_ADDRS; i++)
+        ASSERT(inet_pton(AF_INET, inet_v4_text[i], &addr) == 1);
+
+    bench_keep(addr.s_addr);
+}
+
+static void run_pton6(void* arg) {
+    struct in6_addr addr;
+
+    for (size_t i = 0; i < INET_ADDRS; i++)
+        ASSERT(inet_pton(AF_INET6, inet_v6_text[i], &addr) == 1);
+
+    bench_keep(addr.s6_addr[15]);
+}
+
+static void run_ntop4(void* arg) {
+    char buffer[INET_ADDRSTRLEN];
+
+    for (size_t i = 0; i < INET_ADDRS; i++)
+        ASSERT(inet_ntop(AF_INET, &inet_v4[i], buffer, sizeof(buffer)));
+
+    bench_keep(buffer);
+}
+
+static void run_ntop6(void* arg) {
+    char buffer[INET6_ADDRSTRLEN];
+
+    for (size_t i = 0; i < INET_ADDRS; i++)
+        ASSERT(inet_ntop(AF_INET6, &inet_v6[i], buffer, sizeof(buffer)));
+
+    bench_keep(buffer);
+}
+
+static const struct inet_conversion inet_conversions[] = {
+    {"inet.pton", "family=inet", run_pton4},
+    {"inet.pton", "family=inet6", run_pton6},
+    {"inet.ntop", "family=inet", run_ntop4},
+    {"inet.ntop", "family=inet6", run_ntop6},
+};
+
+static int inet_resolve(const struct inet_lookup* lookup) {
+    struct addrinfo  hints = {};
+    struct addrinfo* result;
+
+    hints.ai_family   = lookup->family;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = lookup->flags;
+
+    int ret = getaddrinfo(lookup->host, NULL, &hints, &result);
+
+    if (ret == 0)
+        freeaddrinfo(result);
+
+    return ret;
+}
+
+static void run_getaddrinfo(void* arg) {
+    ASSERT(inet_resolve(arg) == 0);
+}
+
+/* Nothing here may need the network, "localhost" comes out of /etc/hosts */
+static const struct inet_lookup inet_lookups[] = {
+    {"numeric", "192.0.2.1", "inet", AF_INET, AI_NUMERICHOST},
+    {"numeric", "2001:db8::1", "inet6", AF_INET6, AI_NUMERICHOST},
+    {"hosts", "localhost", "inet", AF_INET, 0},
+    {"hosts", "localhost", "unspec", AF_UNSPEC, 0},
+};
+
+/* Addresses of varying length, a mix of short and long groups and of zero runs for IPv6 */
+static void inet_fill() {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    for (size_t i = 0; i < INET_ADDRS; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        inet_v4[i].s_addr = htonl(i % 4 == 0 ? 0x0A000000 | (state & 0xFFFF) : (uint32_t) state);
+
+        memset(&inet_v6[i], 0, sizeof(inet_v6[i]));
+        inet_v6[i].s6_addr[0] = 0x20;
+        inet_v6[i].s6_addr[1] = 0x01;
+        inet_v6[i].s6_addr[2] = 0x0d;
+        inet_v6[i].s6_addr[3] = 0xb8;
+
+        // every other address keeps a run of zero groups in the middle for "::"
+        for (size_t b = i % 2 ? 4 : 10; b < 16; b++)
+            inet_v6[i].s6_addr[b] = state >> (b % 8 * 8);
+
+        ASSERT(inet_ntop(AF_INET, &inet_v4[i], inet_v4_text[i], INET_ADDRSTRLEN));
+        ASSERT(inet_ntop(AF_INET6, &inet_v6[i], inet_v6_text[i], INET6_ADDRSTRLEN));
+    }
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench inet [-n count] [-t target_us]\n");
+}
+
+/*
+ * Byte swapping arrays of header fields through the inlined macros, the exported functions
+ * and the compiler builtins, text to address conversions both ways, and getaddrinfo() on names
+ * that never need the network.
+ */
+int bench_inet(int argc, char* argv[]) {
+    size_t   count     = 4096;
+    uint64_t target_ns = 10000000;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (count == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct inet_ctx ctx = {
+        .src   = bench_map(count * sizeof(uint64_t)),
+        .dst   = bench_map(count * sizeof(uint64_t)),
+        .count = count,
+    };
+
+    for (size_t i = 0; i < count; i++)
+        ((uint64_t*) ctx.src)[i] = i * 0x9e3779b97f4a7c15ULL;
+
+    char params[64];
+
+    for (size_t s = 0; s < sizeof(inet_swaps) / sizeof(inet_swaps[0]); s++) {
+        double ns = bench_loop(inet_swaps[s].func, &ctx, target_ns);
+
+        snprintf(params, sizeof(params), "width=%d impl=%s count=%zu", inet_swaps[s].width,
+                 inet_swaps[s].impl, count);
+        bench_report("inet.bswap", params, "ops/s", count * 1e9 / ns);
+    }
+
+    inet_fill();
+
+    for (size_t c = 0; c < sizeof(inet_conversions) / sizeof(inet_conversions[0]); c++) {
+        const struct inet_conversion* conv = &inet_conversions[c];
+
+        double ns = bench_loop(conv->func, NULL, target_ns);
+        bench_report(conv->name, conv->params, "ops/s", INET_ADDRS * 1e9 / ns);
+    }
+
+    for (size_t l = 0; l < sizeof(inet_lookups) / sizeof(inet_lookups[0]); l++) {
+        const struct inet_lookup* lookup = &inet_lookups[l];
+
+        // a container without /etc/hosts can't resolve localhost, that's no reason to fail
+        if (inet_resolve(lookup) != 0) {
+            fprintf(stderr, "utest: can't resolve %s, skipping it\n", lookup->host);
+            continue;
+        }
+
+        double ns = bench_loop(run_getaddrinfo, (void*) lookup, target_ns);
+
+        snprintf(params, sizeof(params), "%s host=%s family=%s", lookup->name, lookup->host,
+                 lookup->family_name);
+        bench_report("inet.getaddrinfo", params, "ops/s", 1e9 / ns);
+    }
+
+    bench_unmap(ctx.src, count * sizeof(uint64_t));
+    bench_unmap(ctx.dst, count * sizeof(uint64_t));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IO_DEFAULT_BUFFER ((size_t) -1)
+#define IO_MAX_CHUNK      MiB(1)
+#define IO_IOVECS         16
+
+enum io_dir {
+    IO_READ,
+    IO_WRITE,
+};
+
+struct io_ctx {
+    const char* path;
+    size_t      size;
+    size_t      chunk;
+    size_t      buffer;
+    char*       data;
+};
+
+struct io_method {
+    const char* name;
+    enum io_dir dir;
+    bool (*func)(struct io_ctx* ctx);
+};
+
+static const size_t io_stdio_chunks[]  = {8, 128, KiB(4)};
+static const size_t io_stdio_buffers[] = {IO_DEFAULT_BUFFER, 0, KiB(4), KiB(64), MiB(1)};
+static const size_t io_raw_chunks[]    = {KiB(4), KiB(64), MiB(1)};
+
+static FILE* io_fopen(struct io_ctx* ctx, const char* mode) {
+    FILE* file = fopen(ctx->path, mode);
+    ASSERT(file);
+
+    if (ctx->buffer == 0)
+        ASSERT(setvbuf(file, NULL, _IONBF, 0) == 0);
+    else if (ctx->buffer != IO_DEFAULT_BUFFER)
+        ASSERT(setvbuf(file, NULL, _IOFBF, ctx->buffer) == 0);
+
+    return file;
+}
+
+static bool io_fwrite(struct io_ctx* ctx) {
+    FILE* file = io_fopen(ctx, "w");
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(fwrite(ctx->data, ctx->chunk, 1, file) == 1);
+
+    ASSERT(fclose(file) == 0);
+    return true;
+}
+
+static bool io_fread(struct io_ctx* ctx) {
+    FILE* file = io_fopen(ctx, "r");
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(fread(ctx->data, ctx->chunk, 1, file) == 1);
+
+    ASSERT(fclose(file) == 0);
+    return true;
+}
+
+static bool io_write(struct io_ctx* ctx) {
+    int fd = open(ctx->path, O_WRONLY | O_TRUNC);
+    ASSERT(fd != -1);
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(write(fd, ctx->data, ctx->chunk) == (ssize_t) ctx->chunk);
+
+    close(fd);
+    return true;
+}
+
+static bool io_read(struct io_ctx* ctx) {
+    int fd = open(ctx->path, O_RDONLY);
+    ASSERT(fd != -1);
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(read(fd, ctx->data, ctx->chunk) == (ssize_t) ctx->chunk);
+
+    close(fd);
+    return true;
+}
+
+static bool io_pread(struct io_ctx* ctx) {
+    int fd = open(ctx->path, O_RDONLY);
+    ASSERT(fd != -1);
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(pread(fd, ctx->data, ctx->chunk, done) == (ssize_t) ctx->chunk);
+
+    close(fd);
+    return true;
+}
+
+/* Every chunk is gathered from IO_IOVECS pieces, the way a log writer joins header and payload */
+static bool io_pwritev(struct io_ctx* ctx) {
+    struct iovec iov[IO_IOVECS];
+    size_t       piece = ctx->chunk / IO_IOVECS;
+
+    if (piece == 0)
+        return false;
+
+    for (size_t i = 0; i < IO_IOVECS; i++)
+        iov[i] = (struct iovec){ctx->data + i * piece, piece};
+
+    int fd = open(ctx->path, O_WRONLY | O_TRUNC);
+    ASSERT(fd != -1);
+
+    for (size_t done = 0; done < ctx->size; done += piece * IO_IOVECS)
+        ASSERT(pwritev(fd, iov, IO_IOVECS, done) == (ssize_t) (piece * IO_IOVECS));
+
+    close(fd);
+    return true;
+}
+
+static bool io_mmap(struct io_ctx* ctx) {
+    int fd = open(ctx->path, O_RDONLY);
+    ASSERT(fd != -1);
+
+    uint64_t* words = mmap(NULL, ctx->size, PROT_READ, MAP_SHARED, fd, 0);
+    uint64_t  sum   = 0;
+
+    ASSERT(words != MAP_FAILED);
+    close(fd);
+
+    for (size_t i = 0; i < ctx->size / sizeof(uint64_t); i++)
+        sum += words[i];
+
+    bench_keep(sum);
+    ASSERT(munmap(words, ctx->size) == 0);
+
+    return true;
+}
+
+#ifdef O_DIRECT
+/* Filesystems without O_DIRECT support, like tmpfs, refuse the open() with EINVAL */
+static int io_open_direct(struct io_ctx* ctx, int flags) {
+    static bool warned = false;
+
+    int fd = open(ctx->path, flags | O_DIRECT);
+
+    if (fd == -1 && errno == EINVAL) {
+        if (!warned)
+            fprintf(stderr, "utest: %s doesn't support O_DIRECT\n", ctx->path);
+
+        warned = true;
+    }
+    else
+        ASSERT(fd != -1);
+
+    return fd;
+}
+
+static bool io_direct_write(struct io_ctx* ctx) {
+    int fd = io_open_direct(ctx, O_WRONLY);
+
+    if (fd == -1)
+        return false;
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(write(fd, ctx->data, ctx->chunk) == (ssize_t) ctx->chunk);
+
+    close(fd);
+    return true;
+}
+
+static bool io_direct_read(struct io_ctx* ctx) {
+    int fd = io_open_direct(ctx, O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    for (size_t done = 0; done < ctx->size; done += ctx->chunk)
+        ASSERT(read(fd, ctx->data, ctx->chunk) == (ssize_t) ctx->chunk);
+
+    close(fd);
+    return true;
+}
+#endif
+
+/*
+ * Read and write system calls made by the process so far, from the kernel's own accounting.
+ * Returns false if it isn't available. The read() done here is counted by the next call.
+ */
+static bool io_syscalls(uint64_t* count) {
+#ifdef __linux__
+    char buffer[512];
+    int  fd = open("/proc/self/io", O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    if (len <= 0)
+        return false;
+
+    buffer[len] = '\0';
+
+    unsigned long long syscr, syscw;
+    char*              line = strstr(buffer, "syscr:");
+
+    if (!line || sscanf(line, "syscr: %llu syscw: %llu", &syscr, &syscw) != 2)
+        return false;
+
+    *count = syscr + syscw;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void io_run(const struct io_method* method, struct io_ctx* ctx) {
+    uint64_t before, after;
+    bool     counted = io_syscalls(&before);
+    uint64_t start   = bench_now();
+
+    if (!method->func(ctx))
+        return;
+
+    uint64_t elapsed = bench_now() - start;
+
+    counted = counted && io_syscalls(&after);
+
+    char params[64];
+
+    if (ctx->buffer == IO_DEFAULT_BUFFER)
+        snprintf(params, sizeof(params), "method=%s chunk=%zu", method->name, ctx->chunk);
+    else
+        snprintf(params, sizeof(params), "method=%s chunk=%zu buffer=%zu", method->name,
+                 ctx->chunk, ctx->buffer);
+
+    const char* name = method->dir == IO_READ ? "io.read" : "io.write";
+
+    bench_report(name, params, "MB/s", (double) ctx->size / elapsed * 1000);
+
+    // minus the read() of /proc/self/io itself
+    if (counted)
+        bench_report(name, params, "syscalls/MB", (after - before - 1) / (ctx->size / 1e6));
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench io [-d directory] [-s file_size]\n");
+}
+
+/*
+ * Writes and reads back a generated file through stdio at several buffer sizes, plain and
+ * positional syscalls, a mmap() scan and O_DIRECT. Everything but O_DIRECT runs against the
+ * page cache, which is what log writers mostly see.
+ */
+int bench_io(int argc, char* argv[]) {
+    const char* dir  = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    size_t      size = MiB(64);
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "d:s:")) != -1) {
+        switch (opt) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 's':
+            size = bench_size(optarg);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    // every chunk size has to divide the file evenly
+    size = (size + IO_MAX_CHUNK - 1) & ~(IO_MAX_CHUNK - 1);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/utest-io-XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        fprintf(stderr, "utest: %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    close(fd);
+
+    struct io_ctx ctx = {
+        .path = path,
+        .size = size,
+        .data = bench_map(IO_MAX_CHUNK),
+    };
+
+    for (size_t i = 0; i < IO_MAX_CHUNK; i++)
+        ctx.data[i] = 'a' + i % 26;
+
+    static const struct io_method stdio_methods[] = {
+        {"fwrite", IO_WRITE, io_fwrite},
+        {"fread", IO_READ, io_fread},
+    };
+
+    for (size_t m = 0; m < sizeof(stdio_methods) / sizeof(stdio_methods[0]); m++)
+        for (size_t b = 0; b < sizeof(io_stdio_buffers) / sizeof(io_stdio_buffers[0]); b++)
+            for (size_t c = 0; c < sizeof(io_stdio_chunks) / sizeof(io_stdio_chunks[0]); c++) {
+                ctx.buffer = io_stdio_buffers[b];
+                ctx.chunk  = io_stdio_chunks[c];
+
+                // a syscall for every 8 bytes would take minutes and says nothing new
+                if (ctx.buffer == 0 && ctx.chunk < 128)
+                    continue;
+
+                io_run(&stdio_methods[m], &ctx);
+            }
+
+    static const struct io_method raw_methods[] = {
+        {"write", IO_WRITE, io_write},
+        {"pwritev", IO_WRITE, io_pwritev},
+        {"read", IO_READ, io_read},
+        {"pread", IO_READ, io_pread},
+        {"mmap", IO_READ, io_mmap},
+#ifdef O_DIRECT
+        {"direct", IO_WRITE, io_direct_write},
+        {"direct", IO_READ, io_direct_read},
+#endif
+    };
+
+    ctx.buffer = IO_DEFAULT_BUFFER;
+
+    for (size_t m = 0; m < sizeof(raw_methods) / sizeof(raw_methods[0]); m++) {
+        // a scan maps the whole file at once
+        if (raw_methods[m].func == io_mmap) {
+            ctx.chunk = size;
+            io_run(&raw_methods[m], &ctx);
+            continue;
+        }
+
+        for (size_t c = 0; c < sizeof(io_raw_chunks) / sizeof(io_raw_chunks[0]); c++) {
+            ctx.chunk = io_raw_chunks[c];
+            io_run(&raw_methods[m], &ctx);
+        }
+    }
+
+    unlink(path);
+    bench_unmap(ctx.data, IO_MAX_CHUNK);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MALLOC_SLOTS      65536
+#define MALLOC_THREAD_MAX MiB(16)
+#define MALLOC_RING       1024
+#define MALLOC_KEEP       8
+#define MALLOC_SAMPLE_NS  (10 * 1000000ULL)
+
+struct malloc_worker {
+    pthread_t thread;
+    uint64_t  ops;
+    uint64_t  rng;
+    size_t    index;
+    void**    slots;
+    size_t*   sizes;
+    size_t    slot_count;
+} __attribute__((aligned(64)));
+
+/* Single producer, single consumer ring between the two threads of a remote free pair */
+struct malloc_ring {
+    void*  ptrs[MALLOC_RING];
+    size_t head __attribute__((aligned(64)));
+    size_t tail __attribute__((aligned(64)));
+};
+
+struct malloc_workload {
+    const char* name;
+    void (*func)(struct malloc_worker* worker);
+    bool sweep;
+    bool fragmentation;
+};
+
+static const struct malloc_workload* malloc_current;
+
+static volatile int        malloc_stopping;
+static size_t              malloc_class;
+static struct malloc_ring* malloc_rings;
+static pthread_barrier_t   malloc_start;
+
+static uint64_t xorshift(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/* A size in (class / 2, class], so every class is exercised over its whole bin range */
+static size_t malloc_size(struct malloc_worker* worker, size_t class) {
+    size_t half = class / 2;
+    return half + 1 + xorshift(&worker->rng) % (class - half);
+}
+
+static size_t rss_bytes() {
+#ifdef __linux__
+    FILE*         file = fopen("/proc/self/statm", "r");
+    unsigned long size = 0;
+    unsigned long rss  = 0;
+
+    if (!file)
+        return 0;
+
+    if (fscanf(file, "%lu %lu", &size, &rss) != 2)
+        rss = 0;
+
+    fclose(file);
+    return rss * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+/* Replaces a random slot of a bounded live set, touching every new block once */
+static void workload_local(struct malloc_worker* worker) {
+    while (!malloc_stopping) {
+        size_t i    = xorshift(&worker->rng) % worker->slot_count;
+        size_t size = malloc_size(worker, malloc_class);
+
+        free(worker->slots[i]);
+
+        worker->slots[i] = malloc(size);
+        ASSERT(worker->slots[i]);
+
+        *(volatile char*) worker->slots[i] = 'a';
+        worker->sizes[i] = size;
+        worker->ops++;
+    }
+}
+
+/* Even workers allocate and hand the blocks to the next odd worker, which frees them */
+static void workload_remote(struct malloc_worker* worker) {
+    struct malloc_ring* ring = &malloc_rings[worker->index / 2];
+
+    if (worker->index % 2 == 0) {
+        while (!malloc_stopping) {
+            size_t head = ring->head;
+
+            if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == MALLOC_RING) {
+                sched_yield();
+                continue;
+            }
+
+            void* ptr = malloc(malloc_size(worker, malloc_class));
+            ASSERT(ptr);
+
+            *(volatile char*) ptr = 'a';
+
+            ring->ptrs[head % MALLOC_RING] = ptr;
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+
+        return;
+    }
+
+    // whatever is still in the ring when this stops is freed once the producer has been joined
+    while (!malloc_stopping) {
+        size_t tail = ring->tail;
+
+        if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+            sched_yield();
+            continue;
+        }
+
+        free(ring->ptrs[tail % MALLOC_RING]);
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+        worker->ops++;
+    }
+}
+
+/* Grows a block by half its size at a time from 16 bytes up to the largest size class */
+static void workload_realloc(struct malloc_worker* worker) {
+    while (!malloc_stopping) {
+        size_t size = 16;
+        char*  ptr  = malloc(size);
+
+        ASSERT(ptr);
+
+        while (size < malloc_class && !malloc_stopping) {
+            size += size / 2;
+            ptr = realloc(ptr, size);
+
+            ASSERT(ptr);
+            ptr[size - 1] = 'a';
+            worker->ops++;
+        }
+
+        free(ptr);
+    }
+}
+
+static const struct malloc_workload malloc_workloads[] = {
+    {"local", workload_local, true, true},
+    {"remote", workload_remote, true, false},
+    {"realloc", workload_realloc, false, false},
+};
+
+static void* malloc_thread(void* arg) {
+    struct malloc_worker* worker = arg;
+
+    pthread_barrier_wait(&malloc_start);
+    malloc_current->func(worker);
+
+    return NULL;
+}
+
+static void malloc_run(const struct malloc_workload* workload, size_t class, size_t threads,
+                       uint64_t duration) {
+    struct malloc_worker* workers = aligned_alloc(64, threads * sizeof(struct malloc_worker));
+    size_t                slots   = MALLOC_THREAD_MAX / class;
+
+    ASSERT(workers);
+
+    slots = slots < MALLOC_SLOTS ? (slots ? slots : 1) : MALLOC_SLOTS;
+
+    if (workload->func == workload_remote) {
+        malloc_rings = aligned_alloc(64, (threads / 2) * sizeof(struct malloc_ring));
+        ASSERT(malloc_rings);
+        memset(malloc_rings, 0, (threads / 2) * sizeof(struct malloc_ring));
+    }
+
+    malloc_current  = workload;
+    malloc_class    = class;
+    malloc_stopping = 0;
+
+    ASSERT(pthread_barrier_init(&malloc_start, NULL, threads + 1) == 0);
+
+    for (size_t i = 0; i < threads; i++) {
+        struct malloc_worker* worker = &workers[i];
+
+        memset(worker, 0, sizeof(*worker));
+
+        worker->rng        = 0x9e3779b97f4a7c15ULL * (i + 1);
+        worker->index      = i;
+        worker->slot_count = slots;
+        worker->slots      = bench_map(slots * sizeof(void*));
+        worker->sizes      = bench_map(slots * sizeof(size_t));
+
+        // touched up front so they don't count towards the allocator's RSS
+        memset(worker->slots, 0, slots * sizeof(void*));
+        memset(worker->sizes, 0, slots * sizeof(size_t));
+
+        ASSERT(pthread_create(&worker->thread, NULL, malloc_thread, worker) == 0);
+    }
+
+    size_t baseline = rss_bytes();
+
+    pthread_barrier_wait(&malloc_start);
+
+    uint64_t start = bench_now();
+    size_t   peak  = baseline;
+
+    // sample the RSS while the workers run instead of sleeping through the whole duration
+    while (bench_now() - start < duration) {
+        struct timespec ts = {0, MALLOC_SAMPLE_NS};
+        nanosleep(&ts, NULL);
+
+        size_t rss = rss_bytes();
+        peak       = rss > peak ? rss : peak;
+    }
+
+    malloc_stopping = 1;
+
+    for (size_t i = 0; i < threads; i++)
+        ASSERT(pthread_join(workers[i].thread, NULL) == 0);
+
+    uint64_t elapsed = bench_now() - start;
+
+    for (size_t r = 0; workload->func == workload_remote && r < threads / 2; r++)
+        for (size_t t = malloc_rings[r].tail; t != malloc_rings[r].head; t++)
+            free(malloc_rings[r].ptrs[t % MALLOC_RING]);
+    uint64_t total   = 0;
+
+    for (size_t i = 0; i < threads; i++)
+        total += workers[i].ops;
+
+    char params[64];
+    snprintf(params, sizeof(params), "workload=%s size=%zu threads=%zu", workload->name, class,
+             threads);
+
+    bench_report("malloc.ops", params, "ops/s", total * 1e9 / elapsed);
+    bench_report("malloc.rss", params, "MiB (peak over baseline)",
+                 (double) (peak > baseline ? peak - baseline : 0) / MiB(1));
+
+    /*
+     * Free all but every MALLOC_KEEP-th block and see how much of the memory that was touched
+     * the allocator still holds on to for the few blocks left alive. Only the first byte of a
+     * block is ever touched, so the large classes can end up below 1.
+     */
+    if (workload->fragmentation) {
+        size_t live = 0;
+
+        for (size_t i = 0; i < threads; i++)
+            for (size_t s = 0; s < workers[i].slot_count; s++) {
+                if (s % MALLOC_KEEP == 0) {
+                    live += workers[i].sizes[s];
+                    continue;
+                }
+
+                free(workers[i].slots[s]);
+                workers[i].slots[s] = NULL;
+            }
+
+        size_t rss  = rss_bytes();
+        size_t held = rss > baseline ? rss - baseline : 0;
+
+        bench_report("malloc.fragmentation", params, "rss/live", live ? (double) held / live : 0);
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        for (size_t s = 0; s < workers[i].slot_count; s++)
+            free(workers[i].slots[s]);
+
+        bench_unmap(workers[i].slots, workers[i].slot_count * sizeof(void*));
+        bench_unmap(workers[i].sizes, workers[i].slot_count * sizeof(size_t));
+    }
+
+    pthread_barrier_destroy(&malloc_start);
+
+    if (workload->func == workload_remote)
+        free(malloc_rings);
+
+    free(workers);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench malloc [-w workload] [-d duration_ms] [-s max_size] "
+                    "[-t max_threads]\n");
+}
+
+/*
+ * Allocator throughput and memory overhead from one thread up to all online CPUs. Meant to be
+ * run once as is and once with an LD_PRELOAD'ed allocator, then compared.
+ */
+int bench_malloc(int argc, char* argv[]) {
+    const char* only        = NULL;
+    uint64_t    duration    = 200 * 1000000ULL;
+    size_t      max_size    = MiB(1);
+    size_t      max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "w:d:s:t:")) != -1) {
+        switch (opt) {
+        case 'w':
+            only = optarg;
+            break;
+        case 'd':
+            duration = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 's':
+            max_size = bench_size(optarg);
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (max_threads == 0 || max_size < 8) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    for (size_t w = 0; w < sizeof(malloc_workloads) / sizeof(malloc_workloads[0]); w++) {
+        const struct malloc_workload* workload = &malloc_workloads[w];
+
+        if (only && strcmp(only, workload->name) != 0)
+            continue;
+
+        // remote frees always need pairs, one producer and one consumer
+        size_t min_threads = workload->func == workload_remote ? 2 : 1;
+        size_t top         = max_threads < min_threads ? min_threads : max_threads;
+
+        // every power of two from 8 B up, always finishing at the largest size
+        for (size_t class = workload->sweep ? 8 : max_size; class <= max_size;) {
+            for (size_t threads = min_threads; threads <= top; threads *= 2)
+                malloc_run(workload, class, threads, duration);
+
+            size_t next = class * 2;
+            class       = class < max_size && next > max_size ? max_size : next;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAGE_SIZE KiB(4)
+#define HUGE_SIZE MiB(2)
+
+/* Pages touched by the threads before every timed munmap() */
+#define SHOOTDOWN_PAGES 64
+
+enum fault_flags {
+    FAULT_NONE,
+    FAULT_POPULATE,
+    FAULT_HUGEPAGE,
+};
+
+static const char* const fault_flag_names[] = {
+    "none",
+    "populate",
+    "hugepage",
+};
+
+struct protect_ctx {
+    char*  mem;
+    size_t size;
+};
+
+static volatile char* shootdown_mem;
+static size_t         shootdown_gen;
+static size_t         shootdown_acked;
+static volatile int   shootdown_stopping;
+
+static sigjmp_buf        segv_jmp;
+static volatile uint64_t segv_entered;
+
+/*
+ * Maps size bytes and touches every 4 KiB page once, reporting the cost per page of setting up
+ * the mapping and of the first touches separately. Hugepage mappings are aligned to 2 MiB so
+ * every huge page can actually be used.
+ */
+static void mmap_fault(size_t size, enum fault_flags flags, bool write) {
+    size_t   map_size = flags == FAULT_HUGEPAGE ? size + HUGE_SIZE : size;
+    int      map_flag = MAP_PRIVATE | MAP_ANONYMOUS;
+    uint64_t start    = bench_now();
+
+    if (flags == FAULT_POPULATE)
+        map_flag |= MAP_POPULATE;
+
+    char* base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, map_flag, -1, 0);
+    ASSERT(base != MAP_FAILED);
+
+    char* mem = base;
+
+    if (flags == FAULT_HUGEPAGE) {
+        mem = (char*) (((uintptr_t) base + HUGE_SIZE - 1) & ~(HUGE_SIZE - 1));
+
+#ifdef MADV_HUGEPAGE
+        if (madvise(mem, size, MADV_HUGEPAGE) != 0)
+            fprintf(stderr, "utest: MADV_HUGEPAGE failed: %s\n", strerror(errno));
+#endif
+    }
+
+    uint64_t mapped = bench_now();
+
+    for (size_t i = 0; i < size; i += PAGE_SIZE) {
+        if (write)
+            mem[i] = 'a';
+        else
+            bench_keep(((volatile char*) mem)[i]);
+    }
+
+    uint64_t touched = bench_now();
+    size_t   pages   = size / PAGE_SIZE;
+
+    ASSERT(munmap(base, map_size) == 0);
+
+    char params[64];
+    snprintf(params, sizeof(params), "flags=%s access=%s size=%zu", fault_flag_names[flags],
+             write ? "write" : "read", size);
+
+    bench_report("mmap.fault", params, "setup ns/page", (double) (mapped - start) / pages);
+    bench_report("mmap.fault", params, "touch ns/page", (double) (touched - mapped) / pages);
+    bench_report("mmap.fault", params, "total ns/page", (double) (touched - start) / pages);
+}
+
+static void run_mprotect(void* arg) {
+    struct protect_ctx* ctx = arg;
+
+    ASSERT(mprotect(ctx->mem, ctx->size, PROT_READ) == 0);
+    ASSERT(mprotect(ctx->mem, ctx->size, PROT_READ | PROT_WRITE) == 0);
+}
+
+/* One read-only, read-write round trip over a range that is fully populated */
+static void mmap_protect(size_t size) {
+    struct protect_ctx ctx = {bench_map(size), size};
+
+    memset(ctx.mem, 'a', size);
+
+    double ns = bench_loop(run_mprotect, &ctx, 50000000);
+
+    char params[32];
+    snprintf(params, sizeof(params), "size=%zu", size);
+
+    bench_report("mmap.mprotect", params, "ns/toggle", ns);
+    bench_unmap(ctx.mem, size);
+}
+
+/*
+ * The threads stay runnable between generations so the mm stays live on their CPUs, and each
+ * generation reads every page so their TLBs hold entries the munmap() has to shoot down.
+ */
+static void* shootdown_worker(void* arg) {
+    size_t seen = 0;
+
+    while (!shootdown_stopping) {
+        size_t gen = __atomic_load_n(&shootdown_gen, __ATOMIC_ACQUIRE);
+
+        if (gen == seen) {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < SHOOTDOWN_PAGES; i++)
+            bench_keep(shootdown_mem[i * PAGE_SIZE]);
+
+        seen = gen;
+        __atomic_add_fetch(&shootdown_acked, 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+static void mmap_shootdown(size_t threads, size_t iterations, uint64_t* times) {
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    ASSERT(workers);
+
+    shootdown_gen      = 0;
+    shootdown_stopping = 0;
+
+    for (size_t i = 0; i < threads; i++)
+        ASSERT(pthread_create(&workers[i], NULL, shootdown_worker, NULL) == 0);
+
+    for (size_t i = 0; i < iterations; i++) {
+        size_t size = SHOOTDOWN_PAGES * PAGE_SIZE;
+        char*  mem  = bench_map(size);
+
+        memset(mem, 'a', size);
+
+        shootdown_mem   = mem;
+        shootdown_acked = 0;
+        __atomic_add_fetch(&shootdown_gen, 1, __ATOMIC_RELEASE);
+
+        while (__atomic_load_n(&shootdown_acked, __ATOMIC_ACQUIRE) < threads)
+            sched_yield();
+
+        uint64_t start = bench_now();
+        ASSERT(munmap(mem, size) == 0);
+        times[i] = bench_now() - start;
+    }
+
+    shootdown_stopping = 1;
+
+    for (size_t i = 0; i < threads; i++)
+        ASSERT(pthread_join(workers[i], NULL) == 0);
+
+    char params[32];
+    snprintf(params, sizeof(params), "pages=%i threads=%zu", SHOOTDOWN_PAGES, threads);
+
+    bench_report_dist("mmap.munmap", params, times, iterations);
+    free(workers);
+}
+
+static void segv_return(int sig) {
+    segv_entered = bench_now();
+    siglongjmp(segv_jmp, 1);
+}
+
+static void segv_exit(int sig) {
+    exit(0x80 | sig);
+}
+
+/* Fault to handler entry, in process, on a PROT_NONE page */
+static void mmap_segv_handler(size_t iterations, uint64_t* times) {
+    struct sigaction act = {};
+    struct sigaction old;
+    volatile char*   page = bench_map(PAGE_SIZE);
+
+    ASSERT(mprotect((void*) page, PAGE_SIZE, PROT_NONE) == 0);
+
+    act.sa_handler = segv_return;
+    act.sa_flags   = SA_NODEFER;
+
+    ASSERT(sigaction(SIGSEGV, &act, &old) == 0);
+
+    for (size_t i = 0; i < iterations; i++) {
+        volatile uint64_t start = 0;
+
+        if (sigsetjmp(segv_jmp, 1) == 0) {
+            start   = bench_now();
+            page[0] = 'a';
+        }
+
+        times[i] = segv_entered - start;
+    }
+
+    ASSERT(sigaction(SIGSEGV, &old, NULL) == 0);
+    bench_unmap((void*) page, PAGE_SIZE);
+
+    bench_report_dist("mmap.segv", "path=handler", times, iterations);
+}
+
+/*
+ * The fork -> fault -> handler -> exit() -> wait path of the pagefault sub-modes, next to a
+ * child that calls exit() straight away, so the difference is what the fault itself costs.
+ */
+static void mmap_segv_exit(size_t iterations, bool fault, uint64_t* times) {
+    char* page = bench_map(PAGE_SIZE);
+
+    ASSERT(mprotect(page, PAGE_SIZE, PROT_NONE) == 0);
+    fflush(stdout);
+
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now();
+        pid_t    pid   = fork();
+        int      stat;
+
+        ASSERT(pid != -1);
+
+        if (pid == 0) {
+            struct sigaction act = {};
+
+            act.sa_handler = segv_exit;
+            sigaction(SIGSEGV, &act, NULL);
+
+            if (fault)
+                *(volatile char*) page = 'a';
+
+            exit(0x80 | SIGSEGV);
+        }
+
+        ASSERT(waitpid(pid, &stat, 0) == pid);
+        times[i] = bench_now() - start;
+
+        ASSERT(WIFEXITED(stat) && WEXITSTATUS(stat) == (0x80 | SIGSEGV));
+    }
+
+    bench_unmap(page, PAGE_SIZE);
+    bench_report_dist("mmap.segv", fault ? "path=fork+fault+exit" : "path=fork+exit", times,
+                      iterations);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench mmap [-s fault_size] [-n iterations] [-t max_threads]\n");
+}
+
+/*
+ * Costs of the mapping paths a large arena goes through: first-touch faults with and without
+ * MAP_POPULATE and transparent huge pages, mprotect() round trips, munmap() with TLB shootdowns
+ * to the threads that touched the mapping, and SIGSEGV delivery.
+ */
+int bench_mmap(int argc, char* argv[]) {
+    size_t size        = MiB(256);
+    size_t iterations  = 1000;
+    size_t max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "s:n:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            size = bench_size(optarg);
+            break;
+        case 'n':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (size == 0 || iterations == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    mmap_fault(size, FAULT_NONE, true);
+    mmap_fault(size, FAULT_NONE, false);
+    mmap_fault(size, FAULT_POPULATE, true);
+    mmap_fault(size, FAULT_HUGEPAGE, true);
+
+    mmap_protect(PAGE_SIZE);
+    mmap_protect(PAGE_SIZE * SHOOTDOWN_PAGES);
+    mmap_protect(size);
+
+    uint64_t* times = malloc(iterations * sizeof(uint64_t));
+    ASSERT(times);
+
+    mmap_shootdown(0, iterations, times);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+        mmap_shootdown(threads, iterations, times);
+
+    mmap_segv_handler(iterations, times);
+    mmap_segv_exit(iterations, false, times);
+    mmap_segv_exit(iterations, true, times);
+
+    free(times);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum pipe_method {
+    METHOD_RW,
+#ifdef __linux__
+    METHOD_VMSPLICE_READ,
+    METHOD_VMSPLICE_SPLICE,
+#endif
+};
+
+static const char* const pipe_method_names[] = {
+    "rw",
+#ifdef __linux__
+    "vmsplice+read",
+    "vmsplice+splice",
+#endif
+};
+
+/* 0 keeps the default capacity */
+static const int pipe_capacities[] = {0, KiB(16), KiB(256), MiB(1)};
+
+static void pipe_pingpong(size_t samples) {
+    int       to_child[2];
+    int       to_parent[2];
+    char      byte  = 'a';
+    uint64_t* times = malloc(samples * sizeof(uint64_t));
+
+    ASSERT(times);
+    ASSERT(pipe(to_child) == 0);
+    ASSERT(pipe(to_parent) == 0);
+
+    fflush(stdout);
+
+    if (fork() == 0) {
+        for (size_t i = 0; i < samples; i++) {
+            ASSERT(read(to_child[0], &byte, 1) == 1);
+            ASSERT(write(to_parent[1], &byte, 1) == 1);
+        }
+
+        exit(EXIT_SUCCESS);
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        uint64_t start = bench_now();
+
+        ASSERT(write(to_child[1], &byte, 1) == 1);
+        ASSERT(read(to_parent[0], &byte, 1) == 1);
+
+        times[i] = bench_now() - start;
+    }
+
+    int stat;
+    wait(&stat);
+
+    ASSERT(stat == EXIT_SUCCESS);
+
+    bench_report_dist("pipe.pingpong", "size=1", times, samples);
+
+    close(to_child[0]);
+    close(to_child[1]);
+    close(to_parent[0]);
+    close(to_parent[1]);
+    free(times);
+}
+
+static void pipe_reader(int fd, int ack, enum pipe_method method, size_t total) {
+    size_t bufsize = MiB(1);
+    char*  buffer  = malloc(bufsize);
+    int    null    = open("/dev/null", O_WRONLY);
+
+    ASSERT(buffer);
+    ASSERT(null != -1);
+
+    while (total > 0) {
+        ssize_t ret;
+
+#ifdef __linux__
+        if (method == METHOD_VMSPLICE_SPLICE)
+            ret = splice(fd, NULL, null, NULL, bufsize, SPLICE_F_MOVE);
+        else
+#endif
+            ret = read(fd, buffer, bufsize);
+
+        ASSERT(ret > 0);
+        total -= ret;
+    }
+
+    ASSERT(write(ack, "k", 1) == 1);
+    exit(EXIT_SUCCESS);
+}
+
+static void pipe_writer(int fd, enum pipe_method method, const char* buffer, size_t size,
+                        size_t total) {
+    while (total > 0) {
+        size_t  chunk = size < total ? size : total;
+        ssize_t ret;
+
+#ifdef __linux__
+        if (method != METHOD_RW) {
+            // no SPLICE_F_GIFT, the pages are shared with the pipe and their contents don't matter
+            struct iovec iov = {(void*) buffer, chunk};
+            ret              = vmsplice(fd, &iov, 1, 0);
+        }
+        else
+#endif
+            ret = write(fd, buffer, chunk);
+
+        ASSERT(ret > 0);
+        total -= ret;
+    }
+}
+
+/*
+ * Streams total bytes from the parent to a forked reader in writes of the given size and
+ * measures the time until the reader acknowledges having drained all of them.
+ */
+static void pipe_throughput(enum pipe_method method, int capacity, const char* buffer, size_t size,
+                            size_t total) {
+    int  des[2];
+    int  ack[2];
+    char byte;
+
+    ASSERT(pipe(des) == 0);
+    ASSERT(pipe(ack) == 0);
+
+#ifdef F_SETPIPE_SZ
+    if (capacity && fcntl(des[1], F_SETPIPE_SZ, capacity) == -1) {
+        fprintf(stderr, "utest: F_SETPIPE_SZ %i: %s\n", capacity, strerror(errno));
+
+        close(des[0]);
+        close(des[1]);
+        close(ack[0]);
+        close(ack[1]);
+        return;
+    }
+
+    capacity = fcntl(des[1], F_GETPIPE_SZ);
+#endif
+
+    fflush(stdout);
+
+    if (fork() == 0) {
+        close(des[1]);
+        pipe_reader(des[0], ack[1], method, total);
+    }
+
+    close(des[0]);
+
+    uint64_t start = bench_now();
+
+    pipe_writer(des[1], method, buffer, size, total);
+    ASSERT(read(ack[0], &byte, 1) == 1);
+
+    uint64_t elapsed = bench_now() - start;
+
+    int stat;
+    wait(&stat);
+
+    ASSERT(stat == EXIT_SUCCESS);
+
+    char params[64];
+    snprintf(params, sizeof(params), "method=%s pipe=%i size=%zu", pipe_method_names[method],
+             capacity, size);
+
+    bench_report("pipe.throughput", params, "MB/s", total * 1000.0 / elapsed);
+
+    close(des[1]);
+    close(ack[0]);
+    close(ack[1]);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench pipe [-n pingpong_samples] [-s max_size] [-b bytes]\n");
+}
+
+int bench_pipe(int argc, char* argv[]) {
+    size_t samples  = 100000;
+    size_t max_size = MiB(1);
+    size_t bytes    = MiB(256);
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "n:s:b:")) != -1) {
+        switch (opt) {
+        case 'n':
+            samples = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            max_size = bench_size(optarg);
+            break;
+        case 'b':
+            bytes = bench_size(optarg);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    pipe_pingpong(samples);
+
+    char* buffer = bench_map(max_size);
+    memset(buffer, 'a', max_size);
+
+    for (size_t m = 0; m < sizeof(pipe_method_names) / sizeof(pipe_method_names[0]); m++)
+        for (size_t c = 0; c < sizeof(pipe_capacities) / sizeof(pipe_capacities[0]); c++)
+            for (size_t size = 1; size <= max_size; size *= 4) {
+                // small writes are syscall bound, cap them at a million calls per point
+                size_t total = size * 1000000 < bytes ? size * 1000000 : bytes;
+                pipe_throughput(m, pipe_capacities[c], buffer, size, total);
+            }
+
+    bench_unmap(buffer, max_size);
+    return EXIT_SUCCESS;
+}
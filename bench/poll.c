@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Descriptors every waiter thread of the herd test watches */
+#define POLL_HERD_FDS 64
+
+/* Descriptors the process needs besides the pairs */
+#define POLL_SPARE_FDS 64
+
+enum poll_method {
+    METHOD_SELECT,
+    METHOD_POLL,
+#ifdef __linux__
+    METHOD_EPOLL,
+    METHOD_EPOLL_ET,
+#endif
+};
+
+static const char* const poll_method_names[] = {
+    "select",
+    "poll",
+#ifdef __linux__
+    "epoll",
+    "epoll_et",
+#endif
+};
+
+struct poll_set {
+    int*           rfds;
+    int*           wfds;
+    size_t         count;
+    int            maxfd;
+    fd_set         fds;
+    struct pollfd* pfds;
+    int            epoll;
+};
+
+struct poll_waiter {
+    pthread_t thread;
+    int       epoll;
+    long      switches;
+} __attribute__((aligned(64)));
+
+static const size_t poll_counts[] = {10, 100, 1000, 10000, 100000};
+
+static bool poll_sockets;
+
+static int               poll_herd_done[2];
+static int               poll_herd_stop[2];
+static size_t            poll_herd_spurious;
+static volatile int      poll_stopping;
+static pthread_barrier_t poll_start;
+
+static void poll_pair(int fds[2]) {
+    if (poll_sockets)
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0);
+    else
+        ASSERT(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+}
+
+static void poll_open(struct poll_set* set, size_t count, enum poll_method method) {
+    set->rfds  = malloc(count * sizeof(int));
+    set->wfds  = malloc(count * sizeof(int));
+    set->pfds  = malloc(count * sizeof(struct pollfd));
+    set->count = count;
+    set->maxfd = -1;
+    set->epoll = -1;
+
+    ASSERT(set->rfds && set->wfds && set->pfds);
+
+    FD_ZERO(&set->fds);
+
+#ifdef __linux__
+    if (method == METHOD_EPOLL || method == METHOD_EPOLL_ET) {
+        set->epoll = epoll_create1(EPOLL_CLOEXEC);
+        ASSERT(set->epoll != -1);
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        int fds[2];
+
+        poll_pair(fds);
+
+        set->rfds[i] = fds[0];
+        set->wfds[i] = fds[1];
+        set->pfds[i] = (struct pollfd){fds[0], POLLIN, 0};
+        set->maxfd   = fds[0] > set->maxfd ? fds[0] : set->maxfd;
+
+        if (method == METHOD_SELECT)
+            FD_SET(fds[0], &set->fds);
+
+#ifdef __linux__
+        if (set->epoll != -1) {
+            struct epoll_event event = {EPOLLIN, {.u32 = i}};
+
+            if (method == METHOD_EPOLL_ET)
+                event.events |= EPOLLET;
+
+            ASSERT(epoll_ctl(set->epoll, EPOLL_CTL_ADD, fds[0], &event) == 0);
+        }
+#endif
+    }
+}
+
+static void poll_close(struct poll_set* set) {
+    for (size_t i = 0; i < set->count; i++) {
+        close(set->rfds[i]);
+        close(set->wfds[i]);
+    }
+
+    if (set->epoll != -1)
+        close(set->epoll);
+
+    free(set->rfds);
+    free(set->wfds);
+    free(set->pfds);
+}
+
+/*
+ * Waits for the active descriptors and finds out which they are, the way an event loop would,
+ * stopping the scan as soon as all of them turned up. Returns how many went into ready.
+ */
+static size_t poll_wait(struct poll_set* set, enum poll_method method, size_t* ready,
+                        size_t active, void* events) {
+    size_t found = 0;
+    int    ret;
+
+    switch (method) {
+    case METHOD_SELECT: {
+        fd_set fds = set->fds;
+
+        ret = select(set->maxfd + 1, &fds, NULL, NULL, NULL);
+        ASSERT(ret > 0);
+
+        for (size_t i = 0; i < set->count && found < (size_t) ret; i++)
+            if (FD_ISSET(set->rfds[i], &fds))
+                ready[found++] = i;
+
+        break;
+    }
+    case METHOD_POLL:
+        ret = poll(set->pfds, set->count, -1);
+        ASSERT(ret > 0);
+
+        for (size_t i = 0; i < set->count && found < (size_t) ret; i++)
+            if (set->pfds[i].revents & POLLIN)
+                ready[found++] = i;
+
+        break;
+#ifdef __linux__
+    default: {
+        struct epoll_event* evs = events;
+
+        ret = epoll_wait(set->epoll, evs, active, -1);
+        ASSERT(ret > 0);
+
+        for (int i = 0; i < ret; i++)
+            ready[found++] = evs[i].data.u32;
+
+        break;
+    }
+#endif
+    }
+
+    return found;
+}
+
+static void poll_run(enum poll_method method, size_t count, size_t active, size_t iterations) {
+    struct poll_set set;
+    uint64_t*       times  = malloc(iterations * sizeof(uint64_t));
+    size_t*         ready  = malloc(active * sizeof(size_t));
+    void*           events = NULL;
+    uint64_t        state  = 0x9e3779b97f4a7c15ULL;
+    char            byte   = 'a';
+
+    ASSERT(times && ready);
+
+#ifdef __linux__
+    events = malloc(active * sizeof(struct epoll_event));
+    ASSERT(events);
+#endif
+
+    poll_open(&set, count, method);
+
+    for (size_t it = 0; it < iterations; it++) {
+        // a different set of active descriptors every time, with no duplicates among them
+        size_t first  = state % count;
+        size_t stride = count / active;
+
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        for (size_t i = 0; i < active; i++)
+            ASSERT(write(set.wfds[(first + i * stride) % count], &byte, 1) == 1);
+
+        uint64_t start = bench_now();
+        size_t   found = poll_wait(&set, method, ready, active, events);
+
+        times[it] = bench_now() - start;
+
+        ASSERT(found == active);
+
+        for (size_t i = 0; i < found; i++)
+            ASSERT(read(set.rfds[ready[i]], &byte, 1) == 1);
+    }
+
+    char params[96];
+    snprintf(params, sizeof(params), "method=%s fds=%s count=%zu active=%zu",
+             poll_method_names[method], poll_sockets ? "socketpair" : "pipe", count, active);
+
+    bench_report_dist("poll.wakeup", params, times, iterations);
+
+    poll_close(&set);
+    free(times);
+    free(ready);
+    free(events);
+}
+
+#ifdef __linux__
+/*
+ * epoll rechecks readiness before returning, so a thread woken for a byte some other thread
+ * already read goes back to sleep without ever leaving epoll_wait(). Its voluntary context
+ * switches still count every such wakeup.
+ */
+static void* poll_waiter_thread(void* arg) {
+    struct poll_waiter* waiter = arg;
+    struct epoll_event  event;
+    struct rusage       usage;
+    char                byte;
+
+    pthread_barrier_wait(&poll_start);
+
+    ASSERT(getrusage(RUSAGE_THREAD, &usage) == 0);
+    waiter->switches = -usage.ru_nvcsw;
+
+    while (!poll_stopping) {
+        if (epoll_wait(waiter->epoll, &event, 1, -1) != 1)
+            continue;
+
+        if (event.data.fd == poll_herd_stop[0])
+            continue;
+
+        // only one of the woken threads gets the byte, the rest were woken for nothing
+        if (read(event.data.fd, &byte, 1) == 1)
+            ASSERT(write(poll_herd_done[1], &byte, 1) == 1);
+        else
+            __atomic_add_fetch(&poll_herd_spurious, 1, __ATOMIC_RELAXED);
+    }
+
+    // minus the wakeup for stopping
+    ASSERT(getrusage(RUSAGE_THREAD, &usage) == 0);
+    waiter->switches += usage.ru_nvcsw - 1;
+
+    return NULL;
+}
+
+/*
+ * Several threads, each with an epoll instance of its own, all watching the same descriptors.
+ * One byte at a time is written to one of them and the latency is until some thread has read
+ * it. Without EPOLLEXCLUSIVE every thread wakes up for every byte.
+ */
+static void poll_herd(size_t threads, bool exclusive, size_t iterations) {
+    struct poll_waiter* waiters = aligned_alloc(64, threads * sizeof(struct poll_waiter));
+    uint64_t*           times   = malloc(iterations * sizeof(uint64_t));
+    int                 fds[POLL_HERD_FDS][2];
+    char                byte = 'a';
+
+    ASSERT(waiters && times);
+
+    for (size_t i = 0; i < POLL_HERD_FDS; i++)
+        poll_pair(fds[i]);
+
+    ASSERT(pipe2(poll_herd_done, O_CLOEXEC) == 0);
+    ASSERT(pipe2(poll_herd_stop, O_CLOEXEC) == 0);
+
+    poll_herd_spurious = 0;
+    poll_stopping      = 0;
+
+    ASSERT(pthread_barrier_init(&poll_start, NULL, threads + 1) == 0);
+
+    for (size_t t = 0; t < threads; t++) {
+        struct epoll_event event = {EPOLLIN | (exclusive ? EPOLLEXCLUSIVE : 0)};
+
+        waiters[t].epoll = epoll_create1(EPOLL_CLOEXEC);
+        ASSERT(waiters[t].epoll != -1);
+
+        for (size_t i = 0; i < POLL_HERD_FDS; i++) {
+            event.data.fd = fds[i][0];
+            ASSERT(epoll_ctl(waiters[t].epoll, EPOLL_CTL_ADD, fds[i][0], &event) == 0);
+        }
+
+        // stopping has to wake every thread, so this one is never exclusive
+        event = (struct epoll_event){EPOLLIN, {.fd = poll_herd_stop[0]}};
+        ASSERT(epoll_ctl(waiters[t].epoll, EPOLL_CTL_ADD, poll_herd_stop[0], &event) == 0);
+
+        ASSERT(pthread_create(&waiters[t].thread, NULL, poll_waiter_thread, &waiters[t]) == 0);
+    }
+
+    pthread_barrier_wait(&poll_start);
+
+    for (size_t it = 0; it < iterations; it++) {
+        uint64_t start = bench_now();
+
+        ASSERT(write(fds[it % POLL_HERD_FDS][1], &byte, 1) == 1);
+        ASSERT(read(poll_herd_done[0], &byte, 1) == 1);
+
+        times[it] = bench_now() - start;
+    }
+
+    // let the threads woken for the last byte get back to waiting before counting
+    struct timespec settle = {0, 10000000};
+    nanosleep(&settle, NULL);
+
+    size_t spurious = __atomic_load_n(&poll_herd_spurious, __ATOMIC_RELAXED);
+    long   wakeups  = 0;
+
+    poll_stopping = 1;
+    ASSERT(write(poll_herd_stop[1], &byte, 1) == 1);
+
+    for (size_t t = 0; t < threads; t++) {
+        ASSERT(pthread_join(waiters[t].thread, NULL) == 0);
+        close(waiters[t].epoll);
+
+        wakeups += waiters[t].switches;
+    }
+
+    char params[64];
+    snprintf(params, sizeof(params), "method=%s fds=%s threads=%zu",
+             exclusive ? "epoll_exclusive" : "epoll", poll_sockets ? "socketpair" : "pipe",
+             threads);
+
+    bench_report_dist("poll.herd", params, times, iterations);
+    bench_report("poll.herd", params, "wakeups/event", (double) wakeups / iterations);
+    bench_report("poll.herd", params, "spurious/event", (double) spurious / iterations);
+
+    for (size_t i = 0; i < POLL_HERD_FDS; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+
+    close(poll_herd_done[0]);
+    close(poll_herd_done[1]);
+    close(poll_herd_stop[0]);
+    close(poll_herd_stop[1]);
+
+    pthread_barrier_destroy(&poll_start);
+    free(waiters);
+    free(times);
+}
+#endif
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench poll [-s] [-n max_count] [-k active] [-i iterations] "
+                    "[-t max_threads]\n");
+}
+
+/*
+ * What a wakeup costs select(), poll() and epoll as the number of watched descriptors grows from
+ * 10 to 100k while only a few of them are ready at a time, then the thundering herd of several
+ * threads waiting on the same descriptors, with and without EPOLLEXCLUSIVE. -s uses socketpairs
+ * instead of pipes.
+ */
+int bench_poll(int argc, char* argv[]) {
+    size_t max_count   = 100000;
+    size_t active      = 1;
+    size_t iterations  = 1000;
+    size_t max_threads = 4;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "sn:k:i:t:")) != -1) {
+        switch (opt) {
+        case 's':
+            poll_sockets = true;
+            break;
+        case 'n':
+            max_count = strtoull(optarg, NULL, 0);
+            break;
+        case 'k':
+            active = strtoull(optarg, NULL, 0);
+            break;
+        case 'i':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (active == 0 || iterations == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    size_t room = bench_nofile(max_count * 2 + POLL_SPARE_FDS);
+
+    if (room < max_count * 2 + POLL_SPARE_FDS) {
+        max_count = (room - POLL_SPARE_FDS) / 2;
+        fprintf(stderr, "utest: RLIMIT_NOFILE only leaves room for %zu pairs\n", max_count);
+    }
+
+    for (size_t m = 0; m < sizeof(poll_method_names) / sizeof(poll_method_names[0]); m++)
+        for (size_t c = 0; c < sizeof(poll_counts) / sizeof(poll_counts[0]); c++) {
+            size_t count = poll_counts[c];
+
+            if (count > max_count || active > count)
+                continue;
+
+            // descriptors past FD_SETSIZE can't go into an fd_set at all
+            if (m == METHOD_SELECT && count * 2 + POLL_SPARE_FDS > FD_SETSIZE)
+                continue;
+
+            poll_run(m, count, active, iterations);
+        }
+
+#ifdef __linux__
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        poll_herd(threads, false, iterations);
+        poll_herd(threads, true, iterations);
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum printf_sink {
+    SINK_SNPRINTF,
+    SINK_FPRINTF_SHARED,
+    SINK_FPRINTF_PRIVATE,
+    SINK_DPRINTF,
+    SINK_COUNT,
+};
+
+static const char* const printf_sink_names[] = {
+    "snprintf",
+    "fprintf",
+    "fprintf",
+    "dprintf",
+};
+
+struct printf_worker {
+    pthread_t thread;
+    FILE*     file;
+    uint64_t  calls;
+    uint64_t  bytes;
+    uint64_t  counter;
+} __attribute__((aligned(64)));
+
+struct printf_format {
+    const char* name;
+    int (*func)(struct printf_worker* worker);
+};
+
+static const struct printf_format* printf_current;
+
+static enum printf_sink  printf_sink;
+static FILE*             printf_shared;
+static int               printf_null;
+static volatile int      printf_stopping;
+static pthread_barrier_t printf_start;
+
+static const char printf_string[] = "the quick brown fox jumps over";
+
+/*
+ * Every format is passed to snprintf(), fprintf() or dprintf() themselves, the way the tests call
+ * them, rather than to their v* variants through a helper of our own.
+ */
+#define PRINTF_OUT(worker, ...)                                                                    \
+    ({                                                                                             \
+        char printf_buffer[256];                                                                   \
+        int  printf_ret;                                                                           \
+                                                                                                   \
+        switch (printf_sink) {                                                                     \
+        case SINK_SNPRINTF:                                                                        \
+            printf_ret = snprintf(printf_buffer, sizeof(printf_buffer), __VA_ARGS__);              \
+            bench_keep(printf_buffer);                                                             \
+            break;                                                                                 \
+        case SINK_DPRINTF:                                                                         \
+            printf_ret = dprintf(printf_null, __VA_ARGS__);                                        \
+            break;                                                                                 \
+        default:                                                                                   \
+            printf_ret = fprintf((worker)->file, __VA_ARGS__);                                     \
+            break;                                                                                 \
+        }                                                                                          \
+                                                                                                   \
+        printf_ret;                                                                                \
+    })
+
+/* The counter is scrambled so the numbers vary in length like real ones do */
+static uint64_t printf_value(struct printf_worker* worker) {
+    return ++worker->counter * 0x9e3779b97f4a7c15ULL;
+}
+
+static int format_int(struct printf_worker* worker) {
+    return PRINTF_OUT(worker, "%d", (int) printf_value(worker));
+}
+
+static int format_hex(struct printf_worker* worker) {
+    return PRINTF_OUT(worker, "%llx", (unsigned long long) printf_value(worker));
+}
+
+static int format_pointer(struct printf_worker* worker) {
+    return PRINTF_OUT(worker, "%p", (void*) (uintptr_t) printf_value(worker));
+}
+
+static int format_padded(struct printf_worker* worker) {
+    uint64_t value = printf_value(worker);
+    return PRINTF_OUT(worker, "%12d|%-12u|%08x", (int) value, (unsigned) (value >> 32),
+                      (unsigned) value);
+}
+
+/* Hidden from the compiler, which would turn a plain "%s" of a known string into a memcpy() */
+static int format_string(struct printf_worker* worker) {
+    const char* string = printf_string;
+
+    __asm__("" : "+r"(string));
+    return PRINTF_OUT(worker, "%s", string);
+}
+
+static int format_float(struct printf_worker* worker) {
+    return PRINTF_OUT(worker, "%f", (double) printf_value(worker) / 1e12);
+}
+
+static int format_exp(struct printf_worker* worker) {
+    return PRINTF_OUT(worker, "%.3e", (double) printf_value(worker) / 1e12);
+}
+
+/* Roughly what one structured log line costs */
+static int format_log(struct printf_worker* worker) {
+    uint64_t value = printf_value(worker);
+
+    return PRINTF_OUT(worker, "ts=%llu.%06u level=%s msg=\"%s\" id=%08x latency=%.3fms\n",
+                      (unsigned long long) (value >> 34), (unsigned) (value % 1000000), "info",
+                      printf_string, (unsigned) value, (double) (value % 100000) / 1000);
+}
+
+static const struct printf_format printf_formats[] = {
+    {"int", format_int},
+    {"hex", format_hex},
+    {"pointer", format_pointer},
+    {"padded", format_padded},
+    {"string", format_string},
+    {"float", format_float},
+    {"exp", format_exp},
+    {"log", format_log},
+};
+
+static void* printf_thread(void* arg) {
+    struct printf_worker* worker = arg;
+
+    pthread_barrier_wait(&printf_start);
+
+    while (!printf_stopping) {
+        int ret = printf_current->func(worker);
+
+        worker->bytes += ret;
+        worker->calls++;
+    }
+
+    return NULL;
+}
+
+static FILE* printf_open() {
+    FILE* file = fopen("/dev/null", "w");
+    ASSERT(file);
+
+    return file;
+}
+
+static void printf_run(const struct printf_format* format, enum printf_sink sink, size_t threads,
+                       uint64_t duration) {
+    struct printf_worker* workers = aligned_alloc(64, threads * sizeof(struct printf_worker));
+    ASSERT(workers);
+
+    printf_current  = format;
+    printf_sink     = sink;
+    printf_stopping = 0;
+
+    ASSERT(pthread_barrier_init(&printf_start, NULL, threads + 1) == 0);
+
+    for (size_t i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+
+        workers[i].counter = i << 48;
+        workers[i].file    = sink == SINK_FPRINTF_PRIVATE ? printf_open() : printf_shared;
+
+        ASSERT(pthread_create(&workers[i].thread, NULL, printf_thread, &workers[i]) == 0);
+    }
+
+    pthread_barrier_wait(&printf_start);
+
+    uint64_t        start = bench_now();
+    struct timespec ts    = {duration / NSEC_PER_SEC, duration % NSEC_PER_SEC};
+
+    nanosleep(&ts, NULL);
+    printf_stopping = 1;
+
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        ASSERT(pthread_join(workers[i].thread, NULL) == 0);
+
+        calls += workers[i].calls;
+        bytes += workers[i].bytes;
+
+        if (sink == SINK_FPRINTF_PRIVATE)
+            fclose(workers[i].file);
+    }
+
+    uint64_t elapsed = bench_now() - start;
+
+    char params[64];
+    snprintf(params, sizeof(params), "format=%s sink=%s threads=%zu", format->name,
+             printf_sink_names[sink], threads);
+
+    if (sink == SINK_FPRINTF_PRIVATE)
+        strncat(params, " file=private", sizeof(params) - strlen(params) - 1);
+
+    bench_report("printf.throughput", params, "calls/s", calls * 1e9 / elapsed);
+    bench_report("printf.throughput", params, "MB/s", bytes * 1e3 / elapsed);
+
+    pthread_barrier_destroy(&printf_start);
+    free(workers);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench printf [-f format] [-d duration_ms] [-t max_threads]\n");
+}
+
+/*
+ * Formatting throughput into a stack buffer, a FILE on /dev/null and straight to a descriptor.
+ * Several threads writing through one FILE show what its lock costs next to a FILE per thread.
+ */
+int bench_printf(int argc, char* argv[]) {
+    const char* only        = NULL;
+    uint64_t    duration    = 100 * 1000000ULL;
+    size_t      max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "f:d:t:")) != -1) {
+        switch (opt) {
+        case 'f':
+            only = optarg;
+            break;
+        case 'd':
+            duration = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf_shared = printf_open();
+    printf_null   = open("/dev/null", O_WRONLY);
+
+    ASSERT(printf_null != -1);
+
+    for (size_t f = 0; f < sizeof(printf_formats) / sizeof(printf_formats[0]); f++) {
+        if (only && strcmp(only, printf_formats[f].name) != 0)
+            continue;
+
+        for (enum printf_sink sink = 0; sink < SINK_COUNT; sink++)
+            for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+                // with a single thread a private FILE is the same as the shared one
+                if (sink == SINK_FPRINTF_PRIVATE && threads == 1)
+                    continue;
+
+                printf_run(&printf_formats[f], sink, threads, duration);
+
+                // always finish with every CPU busy, even if it isn't a power of two
+                if (threads < max_threads && threads * 2 > max_threads)
+                    printf_run(&printf_formats[f], sink, max_threads, duration);
+            }
+    }
+
+    fclose(printf_shared);
+    close(printf_null);
+
+    return EXIT_SUCCESS;
+}
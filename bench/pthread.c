@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SMALL_STACK KiB(64)
+
+static size_t       churn_per_creator;
+static volatile int started;
+static size_t       finished;
+
+static void* thread_noop(void* arg) {
+    return arg;
+}
+
+static void* thread_finish(void* arg) {
+    __atomic_add_fetch(&finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+enum stack_kind {
+    STACK_DEFAULT,
+    STACK_SMALL,
+    STACK_PREALLOCATED,
+};
+
+static const char* const stack_names[] = {
+    "default",
+    "small",
+    "preallocated",
+};
+
+static void pthread_create_join(size_t iterations, enum stack_kind kind) {
+    pthread_attr_t attr;
+    pthread_t      thread;
+    void*          stack = NULL;
+
+    pthread_attr_init(&attr);
+
+    if (kind == STACK_SMALL)
+        ASSERT(pthread_attr_setstacksize(&attr, SMALL_STACK) == 0);
+    else if (kind == STACK_PREALLOCATED) {
+        // every thread is joined before the next one is created, so one stack is enough
+        stack = bench_map(SMALL_STACK);
+        ASSERT(pthread_attr_setstack(&attr, stack, SMALL_STACK) == 0);
+    }
+
+    uint64_t start = bench_now();
+
+    for (size_t i = 0; i < iterations; i++) {
+        ASSERT(pthread_create(&thread, &attr, thread_noop, NULL) == 0);
+        ASSERT(pthread_join(thread, NULL) == 0);
+    }
+
+    uint64_t elapsed = bench_now() - start;
+
+    char params[32];
+    snprintf(params, sizeof(params), "stack=%s", stack_names[kind]);
+
+    bench_report("pthread.create_join", params, "threads/s", iterations * 1e9 / elapsed);
+
+    pthread_attr_destroy(&attr);
+
+    if (stack)
+        bench_unmap(stack, SMALL_STACK);
+}
+
+static void* churn_creator(void* arg) {
+    pthread_attr_t attr;
+    pthread_t      thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (size_t i = 0; i < churn_per_creator; i++) {
+        int ret;
+
+        // detached threads may not have been reaped yet, back off until they are
+        while ((ret = pthread_create(&thread, &attr, thread_finish, NULL)) == EAGAIN)
+            sched_yield();
+
+        ASSERT(ret == 0);
+    }
+
+    pthread_attr_destroy(&attr);
+    return NULL;
+}
+
+static void pthread_churn(size_t iterations, size_t creators) {
+    pthread_t* threads = malloc(creators * sizeof(pthread_t));
+    ASSERT(threads);
+
+    churn_per_creator = iterations / creators;
+    finished          = 0;
+
+    size_t   total = churn_per_creator * creators;
+    uint64_t start = bench_now();
+
+    for (size_t i = 0; i < creators; i++)
+        ASSERT(pthread_create(&threads[i], NULL, churn_creator, NULL) == 0);
+
+    for (size_t i = 0; i < creators; i++)
+        ASSERT(pthread_join(threads[i], NULL) == 0);
+
+    while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) < total)
+        sched_yield();
+
+    uint64_t elapsed = bench_now() - start;
+
+    char params[32];
+    snprintf(params, sizeof(params), "creators=%zu", creators);
+
+    bench_report("pthread.detached_churn", params, "threads/s", total * 1e9 / elapsed);
+    free(threads);
+}
+
+static void* cancel_deferred(void* arg) {
+    started = 1;
+
+    while (true)
+        sleep(1000);
+
+    return NULL;
+}
+
+static void* cancel_async(void* arg) {
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    started = 1;
+
+    while (true)
+        ;
+
+    return NULL;
+}
+
+/* Time from pthread_cancel() to pthread_join() returning, once the thread is known to run */
+static void pthread_cancel_latency(size_t iterations, bool async, uint64_t* times) {
+    for (size_t i = 0; i < iterations; i++) {
+        pthread_t thread;
+        void*     retval;
+
+        started = 0;
+        ASSERT(pthread_create(&thread, NULL, async ? cancel_async : cancel_deferred, NULL) == 0);
+
+        while (!started)
+            sched_yield();
+
+        uint64_t start = bench_now();
+
+        ASSERT(pthread_cancel(thread) == 0);
+        ASSERT(pthread_join(thread, &retval) == 0);
+
+        times[i] = bench_now() - start;
+
+        ASSERT(retval == PTHREAD_CANCELED);
+    }
+
+    bench_report_dist("pthread.cancel", async ? "type=async" : "type=deferred", times,
+                      iterations);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench pthread [-n iterations] [-c cancel_iterations] "
+                    "[-m max_creators]\n");
+}
+
+int bench_pthread(int argc, char* argv[]) {
+    size_t iterations   = 100000;
+    size_t cancels      = 1000;
+    size_t max_creators = 64;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "n:c:m:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            cancels = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            max_creators = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    pthread_create_join(iterations, STACK_DEFAULT);
+    pthread_create_join(iterations, STACK_SMALL);
+    pthread_create_join(iterations, STACK_PREALLOCATED);
+
+    for (size_t creators = 1; creators <= max_creators; creators *= 2)
+        pthread_churn(iterations, creators);
+
+    uint64_t* times = malloc(cancels * sizeof(uint64_t));
+    ASSERT(times);
+
+    pthread_cancel_latency(cancels, false, times);
+    pthread_cancel_latency(cancels, true, times);
+
+    free(times);
+    return EXIT_SUCCESS;
+}
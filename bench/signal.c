@@ -0,0 +1,325 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum signal_recv {
+    RECV_HANDLER,
+    RECV_SIGWAITINFO,
+#ifdef __linux__
+    RECV_SIGNALFD,
+#endif
+    RECV_COUNT,
+};
+
+enum signal_send {
+    SEND_KILL,
+    SEND_SIGQUEUE,
+    SEND_PTHREAD_KILL,
+    SEND_COUNT,
+};
+
+static const char* const signal_recv_names[] = {
+    "handler",
+    "sigwaitinfo",
+#ifdef __linux__
+    "signalfd",
+#endif
+};
+
+static const char* const signal_send_names[] = {
+    "kill",
+    "sigqueue",
+    "pthread_kill",
+};
+
+struct signal_ctx {
+    enum signal_recv recv;
+    enum signal_send send;
+    size_t           iterations;
+    pthread_t        main_thread;
+    int              ping;
+    int              pong;
+};
+
+static void signal_handler(int sig) {}
+
+static void signal_send(enum signal_send send, pthread_t thread, int sig) {
+    switch (send) {
+    case SEND_KILL:
+        ASSERT(kill(getpid(), sig) == 0);
+        break;
+    case SEND_SIGQUEUE:
+        ASSERT(sigqueue(getpid(), sig, (union sigval){.sival_int = 0x2137}) == 0);
+        break;
+    default:
+        ASSERT(pthread_kill(thread, sig) == 0);
+        break;
+    }
+}
+
+/* Every thread keeps both signals blocked and only lets its own one in while waiting for it */
+static void signal_recv(enum signal_recv recv, int sig, int fd) {
+    sigset_t  set;
+    siginfo_t info;
+
+    switch (recv) {
+    case RECV_HANDLER:
+        pthread_sigmask(SIG_BLOCK, NULL, &set);
+        sigdelset(&set, sig);
+
+        ASSERT(sigsuspend(&set) == -1);
+        break;
+    case RECV_SIGWAITINFO:
+        sigemptyset(&set);
+        sigaddset(&set, sig);
+
+        ASSERT(sigwaitinfo(&set, &info) == sig);
+        break;
+#ifdef __linux__
+    case RECV_SIGNALFD: {
+        struct signalfd_siginfo fdsi;
+
+        ASSERT(read(fd, &fdsi, sizeof(fdsi)) == sizeof(fdsi));
+        ASSERT(fdsi.ssi_signo == sig);
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+}
+
+static int signal_fd(enum signal_recv recv, int sig) {
+#ifdef __linux__
+    if (recv == RECV_SIGNALFD) {
+        sigset_t set;
+
+        sigemptyset(&set);
+        sigaddset(&set, sig);
+
+        int fd = signalfd(-1, &set, 0);
+        ASSERT(fd != -1);
+
+        return fd;
+    }
+#endif
+
+    return -1;
+}
+
+static void* signal_echo(void* arg) {
+    struct signal_ctx* ctx = arg;
+    int                fd  = signal_fd(ctx->recv, ctx->ping);
+
+    for (size_t i = 0; i < ctx->iterations; i++) {
+        signal_recv(ctx->recv, ctx->ping, fd);
+        signal_send(ctx->send, ctx->main_thread, ctx->pong);
+    }
+
+    if (fd != -1)
+        close(fd);
+
+    return NULL;
+}
+
+static void signal_report(const char* name, const char* params, uint64_t* times, size_t count) {
+    bench_report_dist(name, params, times, count);
+    bench_report_hist(name, params, times, count);
+}
+
+static void signal_roundtrip(struct signal_ctx* ctx, bool cross, uint64_t* times) {
+    pthread_t thread = ctx->main_thread;
+    int       fd;
+
+    if (cross) {
+        fd = signal_fd(ctx->recv, ctx->pong);
+        ASSERT(pthread_create(&thread, NULL, signal_echo, ctx) == 0);
+    }
+    else
+        fd = signal_fd(ctx->recv, ctx->ping);
+
+    for (size_t i = 0; i < ctx->iterations; i++) {
+        uint64_t start = bench_now();
+
+        if (cross) {
+            signal_send(ctx->send, thread, ctx->ping);
+            signal_recv(ctx->recv, ctx->pong, fd);
+        }
+        else {
+            signal_send(ctx->send, thread, ctx->ping);
+            signal_recv(ctx->recv, ctx->ping, fd);
+        }
+
+        times[i] = bench_now() - start;
+    }
+
+    if (cross)
+        ASSERT(pthread_join(thread, NULL) == 0);
+
+    if (fd != -1)
+        close(fd);
+
+    char params[64];
+    snprintf(params, sizeof(params), "recv=%s send=%s thread=%s", signal_recv_names[ctx->recv],
+             signal_send_names[ctx->send], cross ? "cross" : "same");
+
+    signal_report("signal.roundtrip", params, times, ctx->iterations);
+}
+
+#ifdef __linux__
+static int    signal_eventfds[2];
+static int    signal_futexes[2];
+static size_t signal_wakeups;
+
+static void futex_post(int* word) {
+    __atomic_store_n(word, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void futex_take(int* word) {
+    while (__atomic_exchange_n(word, 0, __ATOMIC_ACQUIRE) == 0)
+        syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+}
+
+static void* eventfd_echo(void* arg) {
+    uint64_t value;
+
+    for (size_t i = 0; i < signal_wakeups; i++) {
+        ASSERT(read(signal_eventfds[0], &value, sizeof(value)) == sizeof(value));
+        ASSERT(write(signal_eventfds[1], &value, sizeof(value)) == sizeof(value));
+    }
+
+    return NULL;
+}
+
+static void* futex_echo(void* arg) {
+    for (size_t i = 0; i < signal_wakeups; i++) {
+        futex_take(&signal_futexes[0]);
+        futex_post(&signal_futexes[1]);
+    }
+
+    return NULL;
+}
+
+/* The same cross-thread ping-pong over eventfd and futex, for comparison */
+static void signal_baselines(size_t iterations, uint64_t* times) {
+    pthread_t thread;
+    uint64_t  value = 1;
+
+    signal_wakeups     = iterations;
+    signal_eventfds[0] = eventfd(0, 0);
+    signal_eventfds[1] = eventfd(0, 0);
+
+    ASSERT(signal_eventfds[0] != -1);
+    ASSERT(signal_eventfds[1] != -1);
+    ASSERT(pthread_create(&thread, NULL, eventfd_echo, NULL) == 0);
+
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now();
+
+        ASSERT(write(signal_eventfds[0], &value, sizeof(value)) == sizeof(value));
+        ASSERT(read(signal_eventfds[1], &value, sizeof(value)) == sizeof(value));
+
+        times[i] = bench_now() - start;
+    }
+
+    ASSERT(pthread_join(thread, NULL) == 0);
+    close(signal_eventfds[0]);
+    close(signal_eventfds[1]);
+
+    signal_report("signal.roundtrip", "recv=eventfd thread=cross", times, iterations);
+
+    ASSERT(pthread_create(&thread, NULL, futex_echo, NULL) == 0);
+
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now();
+
+        futex_post(&signal_futexes[0]);
+        futex_take(&signal_futexes[1]);
+
+        times[i] = bench_now() - start;
+    }
+
+    ASSERT(pthread_join(thread, NULL) == 0);
+
+    signal_report("signal.roundtrip", "recv=futex thread=cross", times, iterations);
+}
+#endif
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench signal [-n iterations]\n");
+}
+
+/*
+ * Measures signal round trips for every combination of sending and receiving style, both to the
+ * sending thread itself and ping-ponged with a second thread.
+ */
+int bench_signal(int argc, char* argv[]) {
+    size_t iterations = 100000;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct signal_ctx ctx = {
+        .iterations  = iterations,
+        .main_thread = pthread_self(),
+        .ping        = SIGRTMIN,
+        .pong        = SIGRTMIN + 1,
+    };
+
+    struct sigaction act = {};
+    sigset_t         set;
+
+    act.sa_handler = signal_handler;
+    act.sa_flags   = 0;
+
+    ASSERT(sigaction(ctx.ping, &act, NULL) == 0);
+    ASSERT(sigaction(ctx.pong, &act, NULL) == 0);
+
+    sigemptyset(&set);
+    sigaddset(&set, ctx.ping);
+    sigaddset(&set, ctx.pong);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    uint64_t* times = malloc(iterations * sizeof(uint64_t));
+    ASSERT(times);
+
+    for (int cross = 0; cross <= 1; cross++)
+        for (ctx.recv = 0; ctx.recv < RECV_COUNT; ctx.recv++)
+            for (ctx.send = 0; ctx.send < SEND_COUNT; ctx.send++)
+                signal_roundtrip(&ctx, cross, times);
+
+#ifdef __linux__
+    signal_baselines(iterations, times);
+#endif
+
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+    free(times);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,554 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Datagrams moved by one sendmmsg() or recvmmsg() */
+#define SOCKET_BATCH 32
+
+/* The largest datagram sent, UDP can't go much past 64K */
+#define SOCKET_MAX_DGRAM KiB(32)
+
+/* Stream receivers read this much at a time */
+#define SOCKET_RECV_SIZE MiB(1)
+
+/*
+ * How long anything waits for a datagram, which might have been dropped or never sent by a peer
+ * that died. UDP receivers ack at least every 200 ms, so this is only ever reached on a failure.
+ */
+#define SOCKET_DGRAM_TIMEOUT 5
+
+enum socket_method {
+    METHOD_SEND,
+    METHOD_SENDMMSG,
+#ifdef MSG_ZEROCOPY
+    METHOD_ZEROCOPY,
+#endif
+};
+
+static const char* const socket_method_names[] = {
+    "send",
+    "sendmmsg",
+#ifdef MSG_ZEROCOPY
+    "zerocopy",
+#endif
+};
+
+struct socket_transport {
+    const char* name;
+    int         domain;
+    int         type;
+    bool        nodelay;
+};
+
+static const struct socket_transport socket_transports[] = {
+    {"tcp", AF_INET, SOCK_STREAM, false},
+    {"tcp+nodelay", AF_INET, SOCK_STREAM, true},
+    {"udp", AF_INET, SOCK_DGRAM, false},
+    {"unix", AF_UNIX, SOCK_STREAM, false},
+    {"unix_dgram", AF_UNIX, SOCK_DGRAM, false},
+};
+
+static const size_t socket_sizes[]  = {1, KiB(1)};
+static const size_t socket_chunks[] = {64, KiB(1), KiB(8), KiB(32), KiB(256), MiB(1)};
+
+static int socket_loopback(int type, struct sockaddr_in* addr) {
+    socklen_t len = sizeof(*addr);
+    int       fd  = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+
+    ASSERT(fd != -1);
+
+    addr->sin_family      = AF_INET;
+    addr->sin_port        = 0;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ASSERT(bind(fd, (struct sockaddr*) addr, sizeof(*addr)) == 0);
+    ASSERT(getsockname(fd, (struct sockaddr*) addr, &len) == 0);
+
+    return fd;
+}
+
+/* Two connected sockets of the transport, one for the parent and one for the forked peer */
+static void socket_pair(const struct socket_transport* transport, int fds[2]) {
+    struct sockaddr_in addr[2];
+
+    if (transport->domain == AF_UNIX) {
+        ASSERT(socketpair(AF_UNIX, transport->type | SOCK_CLOEXEC, 0, fds) == 0);
+        return;
+    }
+
+    if (transport->type == SOCK_DGRAM) {
+        fds[0] = socket_loopback(SOCK_DGRAM, &addr[0]);
+        fds[1] = socket_loopback(SOCK_DGRAM, &addr[1]);
+
+        ASSERT(connect(fds[0], (struct sockaddr*) &addr[1], sizeof(addr[1])) == 0);
+        ASSERT(connect(fds[1], (struct sockaddr*) &addr[0], sizeof(addr[0])) == 0);
+        return;
+    }
+
+    int listener = socket_loopback(SOCK_STREAM, &addr[0]);
+
+    ASSERT(listen(listener, 1) == 0);
+
+    fds[0] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    ASSERT(fds[0] != -1);
+    ASSERT(connect(fds[0], (struct sockaddr*) &addr[0], sizeof(addr[0])) == 0);
+
+    fds[1] = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+
+    ASSERT(fds[1] != -1);
+    close(listener);
+
+    int one = 1;
+
+    for (int i = 0; i < 2 && transport->nodelay; i++)
+        ASSERT(setsockopt(fds[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0);
+}
+
+static void socket_pingpong(const struct socket_transport* transport, size_t size,
+                            size_t samples) {
+    int       fds[2];
+    char      buffer[KiB(1)];
+    uint64_t* times = malloc(samples * sizeof(uint64_t));
+
+    ASSERT(times);
+    ASSERT(size <= sizeof(buffer));
+
+    memset(buffer, 'a', size);
+    socket_pair(transport, fds);
+
+    // a lost datagram fails the recv() instead of leaving both sides waiting forever
+    if (transport->type == SOCK_DGRAM) {
+        struct timeval timeout = {SOCKET_DGRAM_TIMEOUT, 0};
+
+        for (int i = 0; i < 2; i++)
+            ASSERT(setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+    }
+
+    fflush(stdout);
+
+    /*
+     * MSG_WAITALL makes the stream sockets return whole messages, datagrams always are.
+     * MSG_NOSIGNAL turns a peer that died into a failed assertion instead of a SIGPIPE.
+     */
+    if (fork() == 0) {
+        close(fds[0]);
+
+        for (size_t i = 0; i < samples; i++) {
+            ASSERT(recv(fds[1], buffer, size, MSG_WAITALL) == (ssize_t) size);
+            ASSERT(send(fds[1], buffer, size, MSG_NOSIGNAL) == (ssize_t) size);
+        }
+
+        exit(EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+
+    for (size_t i = 0; i < samples; i++) {
+        uint64_t start = bench_now();
+
+        ASSERT(send(fds[0], buffer, size, MSG_NOSIGNAL) == (ssize_t) size);
+        ASSERT(recv(fds[0], buffer, size, MSG_WAITALL) == (ssize_t) size);
+
+        times[i] = bench_now() - start;
+    }
+
+    int stat;
+    wait(&stat);
+
+    ASSERT(stat == EXIT_SUCCESS);
+
+    char params[64];
+    snprintf(params, sizeof(params), "transport=%s size=%zu", transport->name, size);
+
+    bench_report_dist("socket.pingpong", params, times, samples);
+
+    close(fds[0]);
+    free(times);
+}
+
+#ifdef MSG_ZEROCOPY
+/*
+ * Every MSG_ZEROCOPY send() queues a completion on the socket's error queue, and sends fail with
+ * ENOBUFS once too many are pending. Reaps whatever is there, waiting for some if asked to, and
+ * returns how many sends completed. One completion can cover a range of consecutive sends.
+ */
+static size_t socket_reap(int fd, bool wait) {
+    char          control[128];
+    struct msghdr msg       = {};
+    size_t        completed = 0;
+
+    if (wait) {
+        // POLLERR is always reported, it doesn't need asking for
+        struct pollfd pfd = {fd, 0, 0};
+        ASSERT(poll(&pfd, 1, -1) == 1);
+    }
+
+    for (;;) {
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            ASSERT(errno == EAGAIN || errno == EWOULDBLOCK);
+            return completed;
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            struct sock_extended_err* err = (struct sock_extended_err*) CMSG_DATA(cmsg);
+
+            if (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                completed += err->ee_data - err->ee_info + 1;
+        }
+    }
+}
+#endif
+
+static void socket_send_stream(int fd, enum socket_method method, const char* buffer, size_t size,
+                               size_t total) {
+    int    flags     = MSG_NOSIGNAL;
+    size_t sends     = 0;
+    size_t completed = 0;
+
+#ifdef MSG_ZEROCOPY
+    if (method == METHOD_ZEROCOPY)
+        flags |= MSG_ZEROCOPY;
+#endif
+
+    while (total > 0) {
+        size_t  chunk = size < total ? size : total;
+        ssize_t ret   = send(fd, buffer, chunk, flags);
+
+#ifdef MSG_ZEROCOPY
+        if (method == METHOD_ZEROCOPY) {
+            if (ret == -1 && errno == ENOBUFS) {
+                completed += socket_reap(fd, true);
+                continue;
+            }
+
+            completed += socket_reap(fd, false);
+        }
+#endif
+
+        ASSERT(ret > 0);
+        total -= ret;
+        sends++;
+    }
+
+    // the buffer isn't free to reuse until every send has completed, that's part of the cost
+#ifdef MSG_ZEROCOPY
+    while (method == METHOD_ZEROCOPY && completed < sends)
+        completed += socket_reap(fd, true);
+#endif
+}
+
+static void socket_recv_stream(int fd, size_t total) {
+    char* buffer = bench_map(SOCKET_RECV_SIZE);
+
+    while (total > 0) {
+        ssize_t ret = recv(fd, buffer, SOCKET_RECV_SIZE, 0);
+
+        ASSERT(ret > 0);
+        total -= ret;
+    }
+
+    bench_unmap(buffer, SOCKET_RECV_SIZE);
+}
+
+static void socket_batch(struct mmsghdr* msgs, struct iovec* iovs, char* buffer, size_t size,
+                         bool spread) {
+    for (size_t i = 0; i < SOCKET_BATCH; i++) {
+        iovs[i]         = (struct iovec){spread ? buffer + i * size : buffer, size};
+        msgs[i].msg_hdr = (struct msghdr){.msg_iov = &iovs[i], .msg_iovlen = 1};
+        msgs[i].msg_len = 0;
+    }
+}
+
+/*
+ * UDP drops whatever doesn't fit in the receive buffer, so when window is set the sender waits
+ * for a one byte ack after every window of datagrams. Everywhere else a full socket blocks.
+ */
+static void socket_send_dgram(int fd, enum socket_method method, char* buffer, size_t size,
+                              size_t messages, size_t window) {
+    struct mmsghdr msgs[SOCKET_BATCH];
+    struct iovec   iovs[SOCKET_BATCH];
+    size_t         in_window = 0;
+    char           ack;
+
+    socket_batch(msgs, iovs, buffer, size, false);
+
+    for (size_t sent = 0; sent < messages;) {
+        size_t batch = method == METHOD_SENDMMSG ? SOCKET_BATCH : 1;
+
+        batch = batch < messages - sent ? batch : messages - sent;
+
+        if (window)
+            batch = batch < window - in_window ? batch : window - in_window;
+
+        int ret;
+
+        if (method == METHOD_SENDMMSG)
+            ret = sendmmsg(fd, msgs, batch, MSG_NOSIGNAL);
+        else
+            ret = send(fd, buffer, size, MSG_NOSIGNAL) == (ssize_t) size ? 1 : -1;
+
+        ASSERT(ret > 0);
+
+        sent += ret;
+        in_window += ret;
+
+        if (window && (in_window == window || sent == messages)) {
+            ASSERT(recv(fd, &ack, 1, 0) == 1);
+            in_window = 0;
+        }
+    }
+}
+
+/* Returns the datagrams that arrived, a timed out window counts the rest of it as lost */
+static size_t socket_recv_dgram(int fd, enum socket_method method, size_t size, size_t messages,
+                                size_t window) {
+    struct mmsghdr msgs[SOCKET_BATCH];
+    struct iovec   iovs[SOCKET_BATCH];
+    char*          buffer    = bench_map(SOCKET_BATCH * size);
+    size_t         received  = 0;
+    size_t         in_window = 0;
+
+    socket_batch(msgs, iovs, buffer, size, true);
+
+    for (size_t done = 0; done < messages;) {
+        size_t want = messages - done;
+
+        if (window)
+            want = want < window - in_window ? want : window - in_window;
+
+        int ret;
+
+        if (method == METHOD_SENDMMSG)
+            ret = recvmmsg(fd, msgs, want < SOCKET_BATCH ? want : SOCKET_BATCH, MSG_WAITFORONE,
+                           NULL);
+        else
+            ret = recv(fd, buffer, size, 0) == (ssize_t) size ? 1 : -1;
+
+        if (ret == -1) {
+            ASSERT(window && (errno == EAGAIN || errno == EWOULDBLOCK));
+            ret = want;
+        }
+        else
+            received += ret;
+
+        done += ret;
+        in_window += ret;
+
+        if (window && (in_window == window || done == messages)) {
+            ASSERT(send(fd, "k", 1, MSG_NOSIGNAL) == 1);
+            in_window = 0;
+        }
+    }
+
+    bench_unmap(buffer, SOCKET_BATCH * size);
+    return received;
+}
+
+/*
+ * Streams total bytes from the parent to a forked receiver in chunks of the given size and
+ * measures the time until the receiver reports, over a pipe, how much it got.
+ */
+static void socket_throughput(const struct socket_transport* transport, enum socket_method method,
+                              char* buffer, size_t size, size_t total) {
+    bool   dgram    = transport->type == SOCK_DGRAM;
+    size_t messages = total / size;
+    size_t window   = 0;
+    int    fds[2];
+    int    ack[2];
+
+    socket_pair(transport, fds);
+    ASSERT(pipe(ack) == 0);
+
+#ifdef MSG_ZEROCOPY
+    int one = 1;
+
+    if (method == METHOD_ZEROCOPY && setsockopt(fds[0], SOL_SOCKET, SO_ZEROCOPY, &one,
+                                                sizeof(one)) != 0) {
+        fprintf(stderr, "utest: SO_ZEROCOPY: %s\n", strerror(errno));
+
+        close(fds[0]);
+        close(fds[1]);
+        close(ack[0]);
+        close(ack[1]);
+        return;
+    }
+#endif
+
+    // a quarter of the receive buffer per window leaves room for the per packet overhead
+    if (dgram && transport->domain == AF_INET) {
+        int       rcvbuf;
+        socklen_t len = sizeof(rcvbuf);
+
+        ASSERT(getsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &rcvbuf, &len) == 0);
+
+        window = rcvbuf / 4 / (size + KiB(1));
+        window = window ? window : 1;
+
+        struct timeval timeout = {0, 200000};
+        ASSERT(setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+
+        // a receiver that died never acks, the sender fails instead of waiting forever
+        timeout = (struct timeval){SOCKET_DGRAM_TIMEOUT, 0};
+        ASSERT(setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+    }
+
+    fflush(stdout);
+
+    if (fork() == 0) {
+        size_t received = total;
+
+        close(fds[0]);
+        close(ack[0]);
+
+        if (dgram)
+            received = socket_recv_dgram(fds[1], method, size, messages, window) * size;
+        else
+            socket_recv_stream(fds[1], total);
+
+        ASSERT(write(ack[1], &received, sizeof(received)) == sizeof(received));
+        exit(EXIT_SUCCESS);
+    }
+
+    // with the write end closed, a receiver that died reads as EOF instead of blocking
+    close(fds[1]);
+    close(ack[1]);
+
+    size_t   received;
+    uint64_t start = bench_now();
+
+    if (dgram)
+        socket_send_dgram(fds[0], method, buffer, size, messages, window);
+    else
+        socket_send_stream(fds[0], method, buffer, size, total);
+
+    ASSERT(read(ack[0], &received, sizeof(received)) == sizeof(received));
+
+    uint64_t elapsed = bench_now() - start;
+
+    int stat;
+    wait(&stat);
+
+    ASSERT(stat == EXIT_SUCCESS);
+
+    char params[64];
+    snprintf(params, sizeof(params), "transport=%s method=%s size=%zu", transport->name,
+             socket_method_names[method], size);
+
+    bench_report("socket.throughput", params, "MB/s", received * 1000.0 / elapsed);
+
+    if (received < messages * size)
+        bench_report("socket.throughput", params, "% lost",
+                     100.0 * (messages * size - received) / (messages * size));
+
+    close(fds[0]);
+    close(ack[0]);
+}
+
+/* Batching only exists for datagrams, zero copy only for TCP and only pays off for large sends */
+static bool socket_applies(const struct socket_transport* transport, enum socket_method method,
+                           size_t size) {
+    bool dgram = transport->type == SOCK_DGRAM;
+
+    if (dgram && size > SOCKET_MAX_DGRAM)
+        return false;
+
+    if (method == METHOD_SENDMMSG)
+        return dgram;
+
+#ifdef MSG_ZEROCOPY
+    if (method == METHOD_ZEROCOPY)
+        return transport->domain == AF_INET && !dgram && size >= KiB(32);
+#endif
+
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench socket [-T transport] [-n pingpong_samples] "
+                    "[-s max_size] [-b bytes]\n");
+}
+
+/*
+ * Round trips and streaming over loopback TCP, with and without Nagle, UDP, and Unix stream and
+ * datagram sockets, all between a parent and a forked peer. Datagrams also go in batches through
+ * sendmmsg()/recvmmsg(), and large TCP sends also go through MSG_ZEROCOPY, which on loopback
+ * still ends up copied on the receiving side, so it shows what the completion handling costs.
+ */
+int bench_socket(int argc, char* argv[]) {
+    const char* only     = NULL;
+    size_t      samples  = 10000;
+    size_t      max_size = MiB(1);
+    size_t      bytes    = MiB(64);
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "T:n:s:b:")) != -1) {
+        switch (opt) {
+        case 'T':
+            only = optarg;
+            break;
+        case 'n':
+            samples = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            max_size = bench_size(optarg);
+            break;
+        case 'b':
+            bytes = bench_size(optarg);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    char* buffer = bench_map(max_size);
+    memset(buffer, 'a', max_size);
+
+    for (size_t t = 0; t < sizeof(socket_transports) / sizeof(socket_transports[0]); t++) {
+        const struct socket_transport* transport = &socket_transports[t];
+
+        if (only && strcmp(only, transport->name) != 0)
+            continue;
+
+        for (size_t s = 0; s < sizeof(socket_sizes) / sizeof(socket_sizes[0]); s++)
+            socket_pingpong(transport, socket_sizes[s], samples);
+
+        for (size_t m = 0; m < sizeof(socket_method_names) / sizeof(socket_method_names[0]); m++)
+            for (size_t c = 0; c < sizeof(socket_chunks) / sizeof(socket_chunks[0]); c++) {
+                size_t size = socket_chunks[c];
+
+                if (size > max_size || !socket_applies(transport, m, size))
+                    continue;
+
+                // small sends are syscall bound, cap them at a hundred thousand per point
+                size_t total = size * 100000 < bytes ? size * 100000 : bytes;
+                socket_throughput(transport, m, buffer, size, total);
+            }
+    }
+
+    bench_unmap(buffer, max_size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/wait.h>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SPAWN_MAX_RSS 8
+
+extern char** environ;
+
+static char* const spawn_argv[3] = {
+    "utest",
+    "exit",
+    NULL,
+};
+
+static pid_t spawn_fork() {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execve("utest", spawn_argv, environ);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+static pid_t spawn_vfork() {
+    pid_t pid = vfork();
+
+    if (pid == 0) {
+        execve("utest", spawn_argv, environ);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+#ifdef __linux__
+static int spawn_clone_child(void* arg) {
+    execve("utest", spawn_argv, environ);
+    _exit(127);
+}
+
+static pid_t spawn_clone() {
+    static char stack[KiB(64)] __attribute__((aligned(16)));
+
+    // the parent is suspended until the child execs, so a single stack can be reused
+    return clone(spawn_clone_child, stack + sizeof(stack), CLONE_VM | CLONE_VFORK | SIGCHLD, NULL);
+}
+#endif
+
+static pid_t spawn_posix_spawn() {
+    pid_t pid;
+
+    if (posix_spawn(&pid, "utest", NULL, NULL, spawn_argv, environ) != 0)
+        return -1;
+
+    return pid;
+}
+
+static const struct {
+    const char* name;
+    pid_t (*spawn)();
+} spawn_methods[] = {
+    {"fork", spawn_fork},
+    {"vfork", spawn_vfork},
+#ifdef __linux__
+    {"clone", spawn_clone},
+#endif
+    {"posix_spawn", spawn_posix_spawn},
+};
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench spawn [-n iterations] [-r rss[,rss...]]\n");
+}
+
+/*
+ * Times the full spawn -> exec("utest exit") -> wait cycle with the parent holding various
+ * amounts of touched anonymous memory, to expose page table copying and copy-on-write setup.
+ */
+int bench_spawn(int argc, char* argv[]) {
+    size_t iterations         = 200;
+    size_t rss[SPAWN_MAX_RSS] = {0, MiB(256), GiB(4)};
+    size_t rss_count          = 3;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = strtoull(optarg, NULL, 0);
+            break;
+        case 'r': {
+            // not strtok(), argv has to stay intact for repeated runs
+            const char* tok = optarg;
+            rss_count       = 0;
+
+            while (tok && rss_count < SPAWN_MAX_RSS) {
+                rss[rss_count++] = bench_size(tok);
+                tok              = strchr(tok, ',');
+
+                if (tok)
+                    tok++;
+            }
+
+            break;
+        }
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (access("utest", X_OK) != 0) {
+        fprintf(stderr, "utest: bench spawn must be run from the directory containing utest\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t* times = malloc(iterations * sizeof(uint64_t));
+    ASSERT(times);
+
+    // the spawned instances print their banner, keep it out of the results
+    fflush(stdout);
+
+    int null      = open("/dev/null", O_WRONLY);
+    int stdout_fd = dup(STDOUT_FILENO);
+
+    ASSERT(null != -1);
+    ASSERT(stdout_fd != -1);
+
+    for (size_t r = 0; r < rss_count; r++) {
+        char* mem = NULL;
+
+        if (rss[r]) {
+            mem = bench_map(rss[r]);
+            memset(mem, 'a', rss[r]);
+        }
+
+        for (size_t m = 0; m < sizeof(spawn_methods) / sizeof(spawn_methods[0]); m++) {
+            ASSERT(dup2(null, STDOUT_FILENO) != -1);
+
+            for (size_t i = 0; i < iterations; i++) {
+                uint64_t start = bench_now();
+                pid_t    pid   = spawn_methods[m].spawn();
+                int      stat;
+
+                ASSERT(pid != -1);
+                ASSERT(waitpid(pid, &stat, 0) == pid);
+
+                times[i] = bench_now() - start;
+
+                ASSERT(WIFEXITED(stat) && WEXITSTATUS(stat) == 0);
+            }
+
+            ASSERT(dup2(stdout_fd, STDOUT_FILENO) != -1);
+
+            char params[64];
+            snprintf(params, sizeof(params), "method=%s rss=%zu", spawn_methods[m].name, rss[r]);
+
+            bench_report_dist("spawn.exec", params, times, iterations);
+            fflush(stdout);
+        }
+
+        if (mem)
+            bench_unmap(mem, rss[r]);
+    }
+
+    close(null);
+    close(stdout_fd);
+    free(times);
+
+    return EXIT_SUCCESS;
+}
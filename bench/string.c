@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUF_SRC 0x01
+#define BUF_DST 0x02
+
+struct string_ctx {
+    char*  dst;
+    char*  src;
+    size_t size;
+};
+
+struct string_func {
+    const char* name;
+    void (*func)(void* arg);
+    int bufs;
+};
+
+/*
+ * Every function is run over a buffer of ctx->size bytes. The buffers are filled with 'a' and
+ * the last byte is a NUL, so the str* functions walk the whole buffer and none of the searches
+ * ever finds a match.
+ */
+static void run_memccpy(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memccpy(ctx->dst, ctx->src, 'z', ctx->size));
+}
+
+static void run_memchr(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memchr(ctx->src, 'z', ctx->size));
+}
+
+static void run_memcmp(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memcmp(ctx->dst, ctx->src, ctx->size));
+}
+
+static void run_memcpy(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memcpy(ctx->dst, ctx->src, ctx->size));
+}
+
+static void run_memmove(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memmove(ctx->dst, ctx->src, ctx->size));
+}
+
+static void run_memset(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(memset(ctx->dst, 'a', ctx->size));
+}
+
+static void run_stpcpy(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(stpcpy(ctx->dst, ctx->src));
+}
+
+static void run_strcat(void* arg) {
+    struct string_ctx* ctx = arg;
+
+    ctx->dst[0] = '\0';
+    bench_keep(strcat(ctx->dst, ctx->src));
+}
+
+static void run_strchr(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strchr(ctx->src, 'z'));
+}
+
+static void run_strcmp(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strcmp(ctx->dst, ctx->src));
+}
+
+static void run_strncmp(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strncmp(ctx->dst, ctx->src, ctx->size));
+}
+
+static void run_strcpy(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strcpy(ctx->dst, ctx->src));
+}
+
+static void run_strncpy(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strncpy(ctx->dst, ctx->src, ctx->size));
+}
+
+static void run_strcspn(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strcspn(ctx->src, "z"));
+}
+
+static void run_strlen(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strlen(ctx->src));
+}
+
+static void run_strpbrk(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strpbrk(ctx->src, "z"));
+}
+
+static void run_strrchr(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strrchr(ctx->src, 'z'));
+}
+
+static void run_strspn(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strspn(ctx->src, "a"));
+}
+
+static void run_strstr(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strstr(ctx->src, "zz"));
+}
+
+static void run_strtok(void* arg) {
+    struct string_ctx* ctx = arg;
+    bench_keep(strtok(ctx->src, "z"));
+}
+
+static const struct string_func string_funcs[] = {
+    {"memccpy", run_memccpy, BUF_SRC | BUF_DST},
+    {"memchr", run_memchr, BUF_SRC},
+    {"memcmp", run_memcmp, BUF_SRC | BUF_DST},
+    {"memcpy", run_memcpy, BUF_SRC | BUF_DST},
+    {"memmove", run_memmove, BUF_SRC | BUF_DST},
+    {"memset", run_memset, BUF_DST},
+    {"stpcpy", run_stpcpy, BUF_SRC | BUF_DST},
+    {"strcat", run_strcat, BUF_SRC | BUF_DST},
+    {"strchr", run_strchr, BUF_SRC},
+    {"strcmp", run_strcmp, BUF_SRC | BUF_DST},
+    {"strncmp", run_strncmp, BUF_SRC | BUF_DST},
+    {"strcpy", run_strcpy, BUF_SRC | BUF_DST},
+    {"strncpy", run_strncpy, BUF_SRC | BUF_DST},
+    {"strcspn", run_strcspn, BUF_SRC},
+    {"strlen", run_strlen, BUF_SRC},
+    {"strpbrk", run_strpbrk, BUF_SRC},
+    {"strrchr", run_strrchr, BUF_SRC},
+    {"strspn", run_strspn, BUF_SRC},
+    {"strstr", run_strstr, BUF_SRC},
+    {"strtok", run_strtok, BUF_SRC},
+};
+
+static void string_point(const struct string_func* func, struct string_ctx* ctx, char* src_base,
+                         char* dst_base, size_t src_align, size_t dst_align, uint64_t target_ns) {
+    char name[32];
+    char params[64];
+
+    ctx->src = src_base + src_align;
+    ctx->dst = dst_base + dst_align;
+
+    ctx->src[ctx->size - 1] = '\0';
+    ctx->dst[ctx->size - 1] = '\0';
+
+    double ns = bench_loop(func->func, ctx, target_ns);
+
+    ctx->src[ctx->size - 1] = 'a';
+    ctx->dst[ctx->size - 1] = 'a';
+
+    snprintf(name, sizeof(name), "string.%s", func->name);
+    snprintf(params, sizeof(params), "size=%zu src=%zu dst=%zu", ctx->size, src_align, dst_align);
+
+    bench_report(name, params, "ns/call", ns);
+    bench_report(name, params, "GB/s", ctx->size / ns);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench string [-f function] [-m min_size] [-s max_size] "
+                    "[-a max_align] [-t target_us] [-p]\n");
+}
+
+/*
+ * Sweeps the mem* and str* functions over power of two sizes and buffer misalignments. By default
+ * the source and destination alignments are swept one at a time, -p sweeps every pair instead.
+ */
+int bench_string(int argc, char* argv[]) {
+    const char* only      = NULL;
+    size_t      min_size  = 1;
+    size_t      max_size  = MiB(64);
+    size_t      max_align = 63;
+    uint64_t    target_ns = 1000000;
+    bool        pairs     = false;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "f:m:s:a:t:p")) != -1) {
+        switch (opt) {
+        case 'f':
+            only = optarg;
+            break;
+        case 'm':
+            min_size = bench_size(optarg);
+            break;
+        case 's':
+            max_size = bench_size(optarg);
+            break;
+        case 'a':
+            max_align = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'p':
+            pairs = true;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (min_size == 0 || min_size > max_size) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    size_t map_size = max_size + max_align + sysconf(_SC_PAGESIZE);
+    char*  src_base = bench_map(map_size);
+    char*  dst_base = bench_map(map_size);
+
+    struct string_ctx ctx;
+
+    for (size_t i = 0; i < sizeof(string_funcs) / sizeof(string_funcs[0]); i++) {
+        const struct string_func* func = &string_funcs[i];
+
+        if (only && strcmp(only, func->name) != 0)
+            continue;
+
+        for (ctx.size = min_size; ctx.size <= max_size; ctx.size *= 2) {
+            memset(src_base, 'a', ctx.size + max_align);
+            memset(dst_base, 'a', ctx.size + max_align);
+
+            if (pairs && func->bufs == (BUF_SRC | BUF_DST)) {
+                for (size_t s = 0; s <= max_align; s++)
+                    for (size_t d = 0; d <= max_align; d++)
+                        string_point(func, &ctx, src_base, dst_base, s, d, target_ns);
+
+                continue;
+            }
+
+            if (func->bufs & BUF_SRC)
+                for (size_t s = 0; s <= max_align; s++)
+                    string_point(func, &ctx, src_base, dst_base, s, 0, target_ns);
+
+            if (func->bufs & BUF_DST)
+                for (size_t d = (func->bufs & BUF_SRC) ? 1 : 0; d <= max_align; d++)
+                    string_point(func, &ctx, src_base, dst_base, 0, d, target_ns);
+        }
+    }
+
+    bench_unmap(src_base, map_size);
+    bench_unmap(dst_base, map_size);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHORT_CS 1
+#define LONG_CS  1000
+
+struct sync_worker {
+    pthread_t thread;
+    uint64_t  ops;
+} __attribute__((aligned(64)));
+
+struct sync_prim {
+    const char* name;
+    const char* variant;
+    bool (*init)(int arg);
+    bool (*op)(struct sync_worker* worker);
+    void (*stop)();
+    void (*fini)();
+    int arg;
+};
+
+static const size_t sync_cs_lengths[] = {SHORT_CS, LONG_CS};
+
+static pthread_mutex_t    sync_mutex;
+static pthread_rwlock_t   sync_rwlock;
+static pthread_spinlock_t sync_spin;
+static pthread_cond_t     sync_cond;
+static pthread_barrier_t  sync_barrier;
+static pthread_barrier_t  sync_start;
+
+static const struct sync_prim* sync_current;
+
+static volatile int    sync_stopping;
+static volatile size_t sync_shared;
+static size_t          sync_cs;
+static size_t          sync_tokens;
+static size_t          sync_rounds;
+
+static void critical_section() {
+    for (size_t i = 0; i < sync_cs; i++)
+        sync_shared++;
+}
+
+static bool mutex_setup(int type, int protocol) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+
+    if (pthread_mutexattr_settype(&attr, type) != 0 ||
+        pthread_mutexattr_setprotocol(&attr, protocol) != 0) {
+        pthread_mutexattr_destroy(&attr);
+        return false;
+    }
+
+    int ret = pthread_mutex_init(&sync_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return ret == 0;
+}
+
+static bool mutex_init(int type) {
+    return mutex_setup(type, PTHREAD_PRIO_NONE);
+}
+
+#ifdef _POSIX_THREAD_PRIO_INHERIT
+static bool mutex_pi_init(int type) {
+    return mutex_setup(type, PTHREAD_PRIO_INHERIT);
+}
+#endif
+
+static bool mutex_op(struct sync_worker* worker) {
+    pthread_mutex_lock(&sync_mutex);
+    critical_section();
+    pthread_mutex_unlock(&sync_mutex);
+
+    return true;
+}
+
+static void mutex_fini() {
+    pthread_mutex_destroy(&sync_mutex);
+}
+
+static bool rwlock_init(int type) {
+    return pthread_rwlock_init(&sync_rwlock, NULL) == 0;
+}
+
+/* One write for every nine reads */
+static bool rwlock_op(struct sync_worker* worker) {
+    if (worker->ops % 10 == 0)
+        pthread_rwlock_wrlock(&sync_rwlock);
+    else
+        pthread_rwlock_rdlock(&sync_rwlock);
+
+    critical_section();
+    pthread_rwlock_unlock(&sync_rwlock);
+
+    return true;
+}
+
+static void rwlock_fini() {
+    pthread_rwlock_destroy(&sync_rwlock);
+}
+
+static bool spin_init(int type) {
+    return pthread_spin_init(&sync_spin, PTHREAD_PROCESS_PRIVATE) == 0;
+}
+
+static bool spin_op(struct sync_worker* worker) {
+    pthread_spin_lock(&sync_spin);
+    critical_section();
+    pthread_spin_unlock(&sync_spin);
+
+    return true;
+}
+
+static void spin_fini() {
+    pthread_spin_destroy(&sync_spin);
+}
+
+/* A single token semaphore built out of a mutex and a condition variable */
+static bool cond_init(int broadcast) {
+    sync_tokens = 1;
+
+    if (pthread_mutex_init(&sync_mutex, NULL) != 0)
+        return false;
+
+    return pthread_cond_init(&sync_cond, NULL) == 0;
+}
+
+static bool cond_op(struct sync_worker* worker) {
+    pthread_mutex_lock(&sync_mutex);
+
+    while (sync_tokens == 0 && !sync_stopping)
+        pthread_cond_wait(&sync_cond, &sync_mutex);
+
+    if (sync_tokens == 0) {
+        pthread_mutex_unlock(&sync_mutex);
+        return false;
+    }
+
+    sync_tokens--;
+    pthread_mutex_unlock(&sync_mutex);
+
+    critical_section();
+
+    pthread_mutex_lock(&sync_mutex);
+    sync_tokens++;
+
+    if (sync_current->arg)
+        pthread_cond_broadcast(&sync_cond);
+    else
+        pthread_cond_signal(&sync_cond);
+
+    pthread_mutex_unlock(&sync_mutex);
+    return true;
+}
+
+static void cond_stop() {
+    pthread_mutex_lock(&sync_mutex);
+    pthread_cond_broadcast(&sync_cond);
+    pthread_mutex_unlock(&sync_mutex);
+}
+
+static void cond_fini() {
+    pthread_cond_destroy(&sync_cond);
+    pthread_mutex_destroy(&sync_mutex);
+}
+
+/*
+ * Barrier rounds can't be cut off by the stop flag without leaving some threads stuck in the
+ * barrier, so they run a fixed number of rounds instead.
+ */
+static bool barrier_op(struct sync_worker* worker) {
+    if (worker->ops >= sync_rounds)
+        return false;
+
+    pthread_barrier_wait(&sync_barrier);
+    critical_section();
+
+    return true;
+}
+
+static const struct sync_prim sync_prims[] = {
+    {"sync.mutex", "normal", mutex_init, mutex_op, NULL, mutex_fini, PTHREAD_MUTEX_NORMAL},
+#ifdef __GLIBC__
+    {"sync.mutex", "adaptive", mutex_init, mutex_op, NULL, mutex_fini, PTHREAD_MUTEX_ADAPTIVE_NP},
+#endif
+#ifdef _POSIX_THREAD_PRIO_INHERIT
+    {"sync.mutex", "pi", mutex_pi_init, mutex_op, NULL, mutex_fini, PTHREAD_MUTEX_NORMAL},
+#endif
+    {"sync.rwlock", "10%write", rwlock_init, rwlock_op, NULL, rwlock_fini, 0},
+    {"sync.spinlock", "private", spin_init, spin_op, NULL, spin_fini, 0},
+    {"sync.cond", "signal", cond_init, cond_op, cond_stop, cond_fini, 0},
+    {"sync.cond", "broadcast", cond_init, cond_op, cond_stop, cond_fini, 1},
+    {"sync.barrier", "wait", NULL, barrier_op, NULL, NULL, 0},
+};
+
+static void* sync_worker(void* arg) {
+    struct sync_worker* worker = arg;
+
+    pthread_barrier_wait(&sync_start);
+
+    while (!sync_stopping && sync_current->op(worker))
+        worker->ops++;
+
+    return NULL;
+}
+
+static void sync_run(const struct sync_prim* prim, size_t threads, size_t cs, uint64_t duration) {
+    struct sync_worker* workers = aligned_alloc(64, threads * sizeof(struct sync_worker));
+    ASSERT(workers);
+
+    if (prim->init && !prim->init(prim->arg)) {
+        fprintf(stderr, "utest: %s type=%s isn't supported\n", prim->name, prim->variant);
+        free(workers);
+        return;
+    }
+
+    sync_current  = prim;
+    sync_cs       = cs;
+    sync_stopping = 0;
+
+    ASSERT(pthread_barrier_init(&sync_start, NULL, threads + 1) == 0);
+    ASSERT(pthread_barrier_init(&sync_barrier, NULL, threads) == 0);
+
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].ops = 0;
+        ASSERT(pthread_create(&workers[i].thread, NULL, sync_worker, &workers[i]) == 0);
+    }
+
+    pthread_barrier_wait(&sync_start);
+
+    uint64_t start = bench_now();
+
+    if (prim->op != barrier_op) {
+        struct timespec ts = {duration / NSEC_PER_SEC, duration % NSEC_PER_SEC};
+        nanosleep(&ts, NULL);
+
+        sync_stopping = 1;
+
+        if (prim->stop)
+            prim->stop();
+    }
+
+    for (size_t i = 0; i < threads; i++)
+        ASSERT(pthread_join(workers[i].thread, NULL) == 0);
+
+    uint64_t elapsed = bench_now() - start;
+    uint64_t total   = 0;
+    uint64_t min     = UINT64_MAX;
+    uint64_t max     = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        total += workers[i].ops;
+        min = workers[i].ops < min ? workers[i].ops : min;
+        max = workers[i].ops > max ? workers[i].ops : max;
+    }
+
+    char params[64];
+    snprintf(params, sizeof(params), "type=%s cs=%s threads=%zu", prim->variant,
+             cs == SHORT_CS ? "short" : "long", threads);
+
+    bench_report(prim->name, params, "ops/s", total * 1e9 / elapsed);
+    bench_report(prim->name, params, "fairness (min/max)", max ? (double) min / max : 1);
+
+    printf("%-24s %-40s ops per thread:", prim->name, params);
+
+    for (size_t i = 0; i < threads; i++)
+        printf(" %llu", (unsigned long long) workers[i].ops);
+
+    printf("\n");
+
+    pthread_barrier_destroy(&sync_start);
+    pthread_barrier_destroy(&sync_barrier);
+
+    if (prim->fini)
+        prim->fini();
+
+    free(workers);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench pthread_sync [-d duration_ms] [-r barrier_rounds] "
+                    "[-t max_threads]\n");
+}
+
+/*
+ * Runs every synchronization primitive back to back from one thread up to all online CPUs,
+ * with nothing but the critical section between acquisitions to maximize contention.
+ */
+int bench_pthread_sync(int argc, char* argv[]) {
+    uint64_t duration    = 200 * 1000000ULL;
+    size_t   max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int      opt;
+
+    sync_rounds = 100000;
+
+    while ((opt = getopt(argc, argv, "d:r:t:")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        case 'r':
+            sync_rounds = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            max_threads = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t p = 0; p < sizeof(sync_prims) / sizeof(sync_prims[0]); p++)
+        for (size_t c = 0; c < sizeof(sync_cs_lengths) / sizeof(sync_cs_lengths[0]); c++)
+            for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+                sync_run(&sync_prims[p], threads, sync_cs_lengths[c], duration);
+
+                // always finish with every CPU busy, even if it isn't a power of two
+                if (threads < max_threads && threads * 2 > max_threads)
+                    sync_run(&sync_prims[p], max_threads, sync_cs_lengths[c], duration);
+            }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+#include <sys/time.h>
+#include <sys/utsname.h>
+
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <sys/syscall.h>
+#endif
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct syscall_call {
+    const char* name;
+    const char* params;
+    void (*libc)(void* arg);
+    void (*raw)(void* arg);
+    clockid_t clock;
+};
+
+static pid_t syscall_pid;
+static int   syscall_fd;
+
+/*
+ * Every call comes as the libc function and as the same call made through syscall(), which
+ * always enters the kernel. For vDSO backed calls the gap between the two is what the vDSO saves.
+ */
+#ifdef __linux__
+#define SYSCALL_RAW(name, ...)                                                                     \
+    static void raw_##name(void* arg) {                                                            \
+        bench_keep(syscall(__VA_ARGS__));                                                          \
+    }
+#else
+#define SYSCALL_RAW(name, ...)
+#endif
+
+static void libc_getpid(void* arg) {
+    bench_keep(getpid());
+}
+SYSCALL_RAW(getpid, SYS_getpid)
+
+static void libc_getppid(void* arg) {
+    bench_keep(getppid());
+}
+SYSCALL_RAW(getppid, SYS_getppid)
+
+static void libc_close(void* arg) {
+    bench_keep(close(-1));
+}
+SYSCALL_RAW(close, SYS_close, -1)
+
+static void libc_fcntl(void* arg) {
+    bench_keep(fcntl(syscall_fd, F_GETFD));
+}
+SYSCALL_RAW(fcntl, SYS_fcntl, syscall_fd, F_GETFD)
+
+static void libc_kill(void* arg) {
+    bench_keep(kill(syscall_pid, 0));
+}
+SYSCALL_RAW(kill, SYS_kill, syscall_pid, 0)
+
+static void libc_read(void* arg) {
+    bench_keep(read(syscall_fd, NULL, 0));
+}
+SYSCALL_RAW(read, SYS_read, syscall_fd, NULL, 0)
+
+static void libc_sched_yield(void* arg) {
+    bench_keep(sched_yield());
+}
+SYSCALL_RAW(sched_yield, SYS_sched_yield)
+
+static void libc_gethostname(void* arg) {
+    char name[256];
+    bench_keep(gethostname(name, sizeof(name)));
+}
+
+#ifdef __linux__
+static void raw_uname(void* arg) {
+    struct utsname* buf = arg;
+    bench_keep(syscall(SYS_uname, buf));
+}
+#endif
+
+/* Never enters the kernel at all, as a floor for the rest */
+static void libc_getenv(void* arg) {
+    bench_keep(getenv("PATH"));
+}
+
+static void libc_clock_gettime(void* arg) {
+    const struct syscall_call* call = arg;
+    struct timespec            ts;
+
+    bench_keep(clock_gettime(call->clock, &ts));
+    bench_keep(ts.tv_nsec);
+}
+
+#ifdef __linux__
+static void raw_clock_gettime(void* arg) {
+    const struct syscall_call* call = arg;
+    struct timespec            ts;
+
+    bench_keep(syscall(SYS_clock_gettime, call->clock, &ts));
+    bench_keep(ts.tv_nsec);
+}
+#endif
+
+static void libc_gettimeofday(void* arg) {
+    struct timeval tv;
+
+    bench_keep(gettimeofday(&tv, NULL));
+    bench_keep(tv.tv_usec);
+}
+
+#ifdef __linux__
+static void raw_gettimeofday(void* arg) {
+    struct timeval tv;
+
+    bench_keep(syscall(SYS_gettimeofday, &tv, NULL));
+    bench_keep(tv.tv_usec);
+}
+
+static void libc_getcpu(void* arg) {
+    bench_keep(sched_getcpu());
+}
+
+static void raw_getcpu(void* arg) {
+    unsigned cpu;
+    bench_keep(syscall(SYS_getcpu, &cpu, NULL, NULL));
+}
+#endif
+
+#ifdef __linux__
+#define RAW(name) raw_##name
+#else
+#define RAW(name) NULL
+#endif
+
+static const struct syscall_call syscall_calls[] = {
+    {"syscall.getpid", "", libc_getpid, RAW(getpid)},
+    {"syscall.getppid", "", libc_getppid, RAW(getppid)},
+    {"syscall.close", "fd=-1", libc_close, RAW(close)},
+    {"syscall.fcntl", "F_GETFD", libc_fcntl, RAW(fcntl)},
+    {"syscall.kill", "sig=0", libc_kill, RAW(kill)},
+    {"syscall.read", "size=0", libc_read, RAW(read)},
+    {"syscall.sched_yield", "", libc_sched_yield, RAW(sched_yield)},
+    {"syscall.gethostname", "", libc_gethostname, RAW(uname)},
+    {"syscall.getenv", "", libc_getenv, NULL},
+};
+
+static const struct syscall_call vdso_calls[] = {
+    {"vdso.clock_gettime", "REALTIME", libc_clock_gettime, RAW(clock_gettime), CLOCK_REALTIME},
+    {"vdso.clock_gettime", "MONOTONIC", libc_clock_gettime, RAW(clock_gettime), CLOCK_MONOTONIC},
+    {"vdso.clock_gettime", "PROCESS_CPUTIME_ID", libc_clock_gettime, RAW(clock_gettime),
+     CLOCK_PROCESS_CPUTIME_ID},
+    {"vdso.clock_gettime", "THREAD_CPUTIME_ID", libc_clock_gettime, RAW(clock_gettime),
+     CLOCK_THREAD_CPUTIME_ID},
+#ifdef CLOCK_MONOTONIC_RAW
+    {"vdso.clock_gettime", "MONOTONIC_RAW", libc_clock_gettime, RAW(clock_gettime),
+     CLOCK_MONOTONIC_RAW},
+#endif
+#ifdef CLOCK_REALTIME_COARSE
+    {"vdso.clock_gettime", "REALTIME_COARSE", libc_clock_gettime, RAW(clock_gettime),
+     CLOCK_REALTIME_COARSE},
+#endif
+#ifdef CLOCK_MONOTONIC_COARSE
+    {"vdso.clock_gettime", "MONOTONIC_COARSE", libc_clock_gettime, RAW(clock_gettime),
+     CLOCK_MONOTONIC_COARSE},
+#endif
+#ifdef CLOCK_BOOTTIME
+    {"vdso.clock_gettime", "BOOTTIME", libc_clock_gettime, RAW(clock_gettime), CLOCK_BOOTTIME},
+#endif
+#ifdef CLOCK_TAI
+    {"vdso.clock_gettime", "TAI", libc_clock_gettime, RAW(clock_gettime), CLOCK_TAI},
+#endif
+    {"vdso.gettimeofday", "", libc_gettimeofday, RAW(gettimeofday)},
+#ifdef __linux__
+    {"vdso.getcpu", "", libc_getcpu, RAW(getcpu)},
+#endif
+};
+
+static double syscall_run(const struct syscall_call* call, void (*func)(void* arg),
+                          const char* impl, uint64_t target_ns) {
+    struct utsname uts;
+    char           params[64];
+
+    // uname() is the only call that needs a buffer of its own, everything else takes the call
+    double ns = bench_loop(func, func == RAW(uname) ? (void*) &uts : (void*) call, target_ns);
+
+    snprintf(params, sizeof(params), "%s%simpl=%s", call->params, call->params[0] ? " " : "",
+             impl);
+    bench_report(call->name, params, "ns/call", ns);
+
+    return ns;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench syscall [-t target_us]\n");
+}
+
+/*
+ * The fixed cost of entering the kernel, through trivial syscalls that do next to no work once
+ * inside, and whether the calls meant to skip the kernel through the vDSO actually do.
+ */
+int bench_syscall(int argc, char* argv[]) {
+    uint64_t target_ns = 10000000;
+    int      opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            target_ns = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    syscall_pid = getpid();
+    syscall_fd  = open("/dev/null", O_RDONLY);
+
+    ASSERT(syscall_fd != -1);
+
+    for (size_t i = 0; i < sizeof(syscall_calls) / sizeof(syscall_calls[0]); i++) {
+        syscall_run(&syscall_calls[i], syscall_calls[i].libc, "libc", target_ns);
+
+        if (syscall_calls[i].raw)
+            syscall_run(&syscall_calls[i], syscall_calls[i].raw, "raw", target_ns);
+    }
+
+#ifdef __linux__
+    printf("%-24s %-40s %#14lx\n", "vdso.mapped", "AT_SYSINFO_EHDR", getauxval(AT_SYSINFO_EHDR));
+#endif
+
+    for (size_t i = 0; i < sizeof(vdso_calls) / sizeof(vdso_calls[0]); i++) {
+        const struct syscall_call* call = &vdso_calls[i];
+
+        double libc = syscall_run(call, call->libc, "libc", target_ns);
+
+        if (!call->raw)
+            continue;
+
+        // well under 1 means the libc call never left user space
+        double raw = syscall_run(call, call->raw, "raw", target_ns);
+        bench_report(call->name, call->params, "libc/raw", libc / raw);
+    }
+
+    close(syscall_fd);
+    return EXIT_SUCCESS;
+}
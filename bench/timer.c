@@ -0,0 +1,304 @@
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "utest.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#endif
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TIMER_MIN_SAMPLES 10
+
+struct timer_method {
+    const char* name;
+    int64_t (*sleep)(uint64_t interval);
+    bool whole_ms;
+};
+
+struct timer_config {
+    const char*   name;
+    int           policy;
+    unsigned long slack;
+};
+
+static const uint64_t timer_intervals[] = {
+    1000, 10000, 100000, 1000000, 10000000, 100000000,
+};
+
+static int     timer_fd    = -1;
+static int     timer_epoll = -1;
+static timer_t timer_posix;
+static int     timer_signal;
+
+static struct timespec timer_ts(uint64_t ns) {
+    return (struct timespec){ns / NSEC_PER_SEC, ns % NSEC_PER_SEC};
+}
+
+/* Every method returns how late it woke up, in ns past the requested interval */
+static int64_t sleep_nanosleep(uint64_t interval) {
+    struct timespec ts    = timer_ts(interval);
+    uint64_t        start = bench_now();
+
+    ASSERT(nanosleep(&ts, NULL) == 0);
+    return bench_now() - start - interval;
+}
+
+/* An absolute deadline on the clock bench_now() reads, so the start doesn't need measuring */
+static int64_t sleep_clock_nanosleep(uint64_t interval) {
+    uint64_t        deadline = bench_now() + interval;
+    struct timespec ts       = timer_ts(deadline);
+
+    ASSERT(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == 0);
+    return bench_now() - deadline;
+}
+
+static int64_t sleep_ppoll(uint64_t interval) {
+    struct timespec ts    = timer_ts(interval);
+    uint64_t        start = bench_now();
+
+    ASSERT(ppoll(NULL, 0, &ts, NULL) == 0);
+    return bench_now() - start - interval;
+}
+
+static int64_t sleep_poll(uint64_t interval) {
+    uint64_t start = bench_now();
+
+    ASSERT(poll(NULL, 0, interval / 1000000) == 0);
+    return bench_now() - start - interval;
+}
+
+static int64_t sleep_timer_create(uint64_t interval) {
+    struct itimerspec its = {.it_value = timer_ts(interval)};
+    sigset_t          set;
+
+    sigemptyset(&set);
+    sigaddset(&set, timer_signal);
+
+    uint64_t start = bench_now();
+
+    ASSERT(timer_settime(timer_posix, 0, &its, NULL) == 0);
+    ASSERT(sigwaitinfo(&set, NULL) == timer_signal);
+
+    return bench_now() - start - interval;
+}
+
+#ifdef __linux__
+static int64_t sleep_timerfd(uint64_t interval) {
+    struct itimerspec its = {.it_value = timer_ts(interval)};
+    uint64_t          expirations;
+    uint64_t          start = bench_now();
+
+    ASSERT(timerfd_settime(timer_fd, 0, &its, NULL) == 0);
+    ASSERT(read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations));
+
+    return bench_now() - start - interval;
+}
+
+static int64_t sleep_epoll_wait(uint64_t interval) {
+    struct epoll_event event;
+    uint64_t           start = bench_now();
+
+    ASSERT(epoll_wait(timer_epoll, &event, 1, interval / 1000000) == 0);
+    return bench_now() - start - interval;
+}
+#endif
+
+/* poll() and epoll_wait() only take milliseconds, so they skip the shorter intervals */
+static const struct timer_method timer_methods[] = {
+    {"nanosleep", sleep_nanosleep, false},
+    {"clock_nanosleep_abs", sleep_clock_nanosleep, false},
+#ifdef __linux__
+    {"timerfd", sleep_timerfd, false},
+#endif
+    {"timer_create", sleep_timer_create, false},
+    {"ppoll", sleep_ppoll, false},
+    {"poll", sleep_poll, true},
+#ifdef __linux__
+    {"epoll_wait", sleep_epoll_wait, true},
+#endif
+};
+
+/* A slack of 0 keeps the default, SCHED_FIFO threads get no slack at all anyway */
+static const struct timer_config timer_configs[] = {
+    {"sched=other slack=default", SCHED_OTHER, 0},
+    {"sched=other slack=1ns", SCHED_OTHER, 1},
+    {"sched=fifo", SCHED_FIFO, 0},
+};
+
+static bool timer_configure(const struct timer_config* config, unsigned long default_slack) {
+    struct sched_param param = {.sched_priority = config->policy == SCHED_FIFO ? 1 : 0};
+
+    if (sched_setscheduler(0, config->policy, &param) != 0) {
+        fprintf(stderr, "utest: can't switch to %s: %s\n", config->name, strerror(errno));
+        return false;
+    }
+
+#ifdef __linux__
+    ASSERT(prctl(PR_SET_TIMERSLACK, config->slack ? config->slack : default_slack) == 0);
+#else
+    if (config->slack) {
+        fprintf(stderr, "utest: timer slack can't be changed here\n");
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+static void timer_run(const struct timer_method* method, const struct timer_config* config,
+                      uint64_t interval, size_t samples, uint64_t* times) {
+    double sum    = 0;
+    double sum_sq = 0;
+    size_t early  = 0;
+
+    for (size_t i = 0; i < samples; i++) {
+        int64_t late = method->sleep(interval);
+
+        // only poll() rounding could wake up early, count it instead of wrapping around
+        if (late < 0) {
+            early++;
+            late = 0;
+        }
+
+        times[i] = late;
+        sum += late;
+        sum_sq += (double) late * late;
+    }
+
+    double mean = sum / samples;
+
+    char params[96];
+    snprintf(params, sizeof(params), "method=%s interval=%llu %s", method->name,
+             (unsigned long long) interval, config->name);
+
+    bench_report_dist("timer.oversleep", params, times, samples);
+    bench_report("timer.oversleep", params, "ns (stddev)", sqrt(sum_sq / samples - mean * mean));
+
+    if (early)
+        bench_report("timer.oversleep", params, "early wakeups", early);
+}
+
+static void usage() {
+    fprintf(stderr, "usage: utest bench timer [-n samples] [-m max_interval_us] [-M method]\n");
+}
+
+/*
+ * How late every way of sleeping wakes up, for intervals from 1 us to 100 ms, under the default
+ * timer slack, the smallest slack and SCHED_FIFO. Longer intervals take fewer samples so every
+ * interval runs for about a second at most.
+ */
+int bench_timer(int argc, char* argv[]) {
+    const char* only         = NULL;
+    size_t      samples      = 1000;
+    uint64_t    max_interval = 100000000;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "n:m:M:")) != -1) {
+        switch (opt) {
+        case 'n':
+            samples = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            max_interval = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'M':
+            only = optarg;
+            break;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (samples == 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct sigevent    event = {};
+    struct sched_param old_param;
+    sigset_t           set;
+    int                old_policy = sched_getscheduler(0);
+
+    sched_getparam(0, &old_param);
+
+    timer_signal = SIGRTMIN;
+
+    sigemptyset(&set);
+    sigaddset(&set, timer_signal);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo  = timer_signal;
+
+    ASSERT(timer_create(CLOCK_MONOTONIC, &event, &timer_posix) == 0);
+
+    unsigned long default_slack = 50000;
+
+#ifdef __linux__
+    default_slack = prctl(PR_GET_TIMERSLACK);
+    timer_fd      = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    timer_epoll   = epoll_create1(EPOLL_CLOEXEC);
+
+    ASSERT(timer_fd != -1);
+    ASSERT(timer_epoll != -1);
+#endif
+
+    uint64_t* times = malloc(samples * sizeof(uint64_t));
+    ASSERT(times);
+
+    for (size_t c = 0; c < sizeof(timer_configs) / sizeof(timer_configs[0]); c++) {
+        if (!timer_configure(&timer_configs[c], default_slack))
+            continue;
+
+        for (size_t m = 0; m < sizeof(timer_methods) / sizeof(timer_methods[0]); m++) {
+            if (only && strcmp(only, timer_methods[m].name) != 0)
+                continue;
+
+            for (size_t i = 0; i < sizeof(timer_intervals) / sizeof(timer_intervals[0]); i++) {
+                uint64_t interval = timer_intervals[i];
+                size_t   count    = NSEC_PER_SEC / interval;
+
+                if (interval > max_interval)
+                    break;
+
+                if (timer_methods[m].whole_ms && interval < 1000000)
+                    continue;
+
+                count = count < TIMER_MIN_SAMPLES ? TIMER_MIN_SAMPLES : count;
+                count = count > samples ? samples : count;
+
+                timer_run(&timer_methods[m], &timer_configs[c], interval, count, times);
+            }
+        }
+    }
+
+    sched_setscheduler(0, old_policy, &old_param);
+
+#ifdef __linux__
+    prctl(PR_SET_TIMERSLACK, default_slack);
+    close(timer_fd);
+    close(timer_epoll);
+#endif
+
+    timer_delete(timer_posix);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+    free(times);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "utest.h"
+
+#include <unistd.h>
+
+/*
+ * Handshakes are a pipe with one byte written per post, so posts are counted, survive fork()
+ * and work on every OS utest runs on.
+ */
+void handshake_init(struct handshake* hs) {
+    ASSERT(pipe(hs->fds) == 0);
+}
+
+void handshake_post(struct handshake* hs) {
+    ASSERT(write(hs->fds[1], "", 1) == 1);
+}
+
+void handshake_wait(struct handshake* hs) {
+    char byte;
+    ASSERT(read(hs->fds[0], &byte, 1) == 1);
+}
+
+void handshake_destroy(struct handshake* hs) {
+    close(hs->fds[0]);
+    close(hs->fds[1]);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KiB(x) ((size_t) (x) << 10)
+#define MiB(x) ((size_t) (x) << 20)
+#define GiB(x) ((size_t) (x) << 30)
+
+#define NSEC_PER_SEC 1000000000ULL
+
+#define BENCH_RESULTS_VERSION 1
+
+/* Makes the compiler believe the value is used, so the call producing it isn't optimized out */
+#define bench_keep(value) __asm__ __volatile__("" : : "g"(value) : "memory")
+
+uint64_t bench_now();
+double   bench_loop(void (*func)(void* arg), void* arg, uint64_t target_ns);
+size_t   bench_size(const char* str);
+void*    bench_map(size_t size);
+void     bench_unmap(void* ptr, size_t size);
+size_t   bench_nofile(size_t count);
+void     bench_report(const char* name, const char* params, const char* unit, double value);
+void     bench_report_dist(const char* name, const char* params, uint64_t* samples, size_t count);
+void     bench_report_hist(const char* name, const char* params, const uint64_t* samples,
+                           size_t count);
+
+int bench_main(int argc, char* argv[]);
+int bench_compare(int argc, char* argv[]);
+
+int bench_string(int argc, char* argv[]);
+int bench_pipe(int argc, char* argv[]);
+int bench_spawn(int argc, char* argv[]);
+int bench_signal(int argc, char* argv[]);
+int bench_pthread(int argc, char* argv[]);
+int bench_pthread_sync(int argc, char* argv[]);
+int bench_fb(int argc, char* argv[]);
+int bench_mmap(int argc, char* argv[]);
+int bench_malloc(int argc, char* argv[]);
+int bench_io(int argc, char* argv[]);
+int bench_printf(int argc, char* argv[]);
+int bench_dir(int argc, char* argv[]);
+int bench_syscall(int argc, char* argv[]);
+int bench_timer(int argc, char* argv[]);
+int bench_ctype(int argc, char* argv[]);
+int bench_complexity(int argc, char* argv[]);
+int bench_inet(int argc, char* argv[]);
+int bench_socket(int argc, char* argv[]);
+int bench_poll(int argc, char* argv[]);
+int bench_fd(int argc, char* argv[]);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOBONG
+
+#define ASSERT_FATAL 0
+#define ASSERT_TAP   1
+#define ASSERT_JSON  2
+
+/*
+ * ASSERT_FATAL exits on the first failed assertion. The other formats, picked with the
+ * UTEST_RESULTS environment variable, log every assertion with its duration instead and dump the
+ * log when the process exits. Only test groups and the sub-modes they spawn call assert_init(),
+ * the runner and the benchmarks stay fatal.
+ */
+extern int assert_format;
+
+int      assert_env();
+void     assert_init();
+uint64_t assert_now();
+void     assert_record(const char* file, int line, const char* expr, bool passed, int err,
+                       uint64_t elapsed);
+bool     assert_failed();
+
+#ifndef NOBONG
+#define ASSERT(condition)                                                                          \
+    ({                                                                                             \
+        printf("%s:%i: %s\n", __FILE__, __LINE__, #condition);                                     \
+                                                                                                   \
+        uint64_t assert_start = assert_format ? assert_now() : 0;                                  \
+        bool     assert_ok    = (condition);                                                       \
+        int      assert_err   = errno;                                                             \
+                                                                                                   \
+        if (assert_format)                                                                         \
+            assert_record(__FILE__, __LINE__, #condition, assert_ok, assert_err,                   \
+                          assert_now() - assert_start);                                            \
+        else if (!assert_ok) {                                                                     \
+            fprintf(stderr, "%s:%i: Assertion failed! (%s), errno = \"%s\"\n", __FILE__, __LINE__, \
+                    #condition, strerror(assert_err));                                             \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    })
+#else
+#define ASSERT(condition)                                                                          \
+    ({                                                                                             \
+        uint64_t assert_start = assert_format ? assert_now() : 0;                                  \
+        bool     assert_ok    = (condition);                                                       \
+        int      assert_err   = errno;                                                             \
+                                                                                                   \
+        if (assert_format)                                                                         \
+            assert_record(__FILE__, __LINE__, #condition, assert_ok, assert_err,                   \
+                          assert_now() - assert_start);                                            \
+        else if (!assert_ok) {                                                                     \
+            fprintf(stderr, "%s:%i: Assertion failed! (%s), errno = \"%s\"\n", __FILE__, __LINE__, \
+                    #condition, strerror(assert_err));                                             \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    })
+#endif
+
+/* Lets a parent and a forked child, or two threads, wait on each other instead of sleeping */
+struct handshake {
+    int fds[2];
+};
+
+void handshake_init(struct handshake* hs);
+void handshake_post(struct handshake* hs);
+void handshake_wait(struct handshake* hs);
+void handshake_destroy(struct handshake* hs);
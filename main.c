@@ -1,5 +1,8 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 
+#include "bench.h"
+#include "utest.h"
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -11,6 +14,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -21,67 +25,64 @@
 #include <time.h>
 #include <unistd.h>
 
-#define NOBONG
-
-#ifndef NOBONG
-#define ASSERT(condition)                                                                          \
-    ({                                                                                             \
-        printf("%s:%i: %s\n", __FILE__, __LINE__, #condition);                                     \
-                                                                                                   \
-        if (!(condition)) {                                                                        \
-            int err = errno;                                                                       \
-            fprintf(stderr, "%s:%i: Assertion failed! (%s), errno = \"%s\"\n", __FILE__, __LINE__, \
-                    #condition, strerror(err));                                                    \
-            exit(EXIT_FAILURE);                                                                    \
-        }                                                                                          \
-    })
-#else
-#define ASSERT(condition)                                                                          \
-    ({                                                                                             \
-        if (!(condition)) {                                                                        \
-            int err = errno;                                                                       \
-            fprintf(stderr, "%s:%i: Assertion failed! (%s), errno = \"%s\"\n", __FILE__, __LINE__, \
-                    #condition, strerror(err));                                                    \
-            exit(EXIT_FAILURE);                                                                    \
-        }                                                                                          \
-    })
-#endif
-
 void test_file();
 void test_inet();
 void test_ctype();
 void test_fb();
 void test_string();
+void test_string_boundary();
 void test_pdevs();
 void test_bong();
 void test_signals();
 void test_pthread();
+void test_stdio();
 
 #if __aex__
 void test_aex();
 #endif
 
+int run_main(int argc, char* argv[]);
+int run_groups(char* const* only, int only_count, long jobs, long timeout);
+
 void fault_handler(int id) {
     exit(0x80 | id);
 }
 
+/* Kept out of stdout when that carries a results stream */
+void banner(int argc, char* argv[]) {
+    FILE* out = assert_env() == ASSERT_FATAL ? stdout : stderr;
+
+    fprintf(out, "utest: aaa (%i)\n", argc);
+
+    if (argc >= 2)
+        fprintf(out, "utest: %s\n", argv[1]);
+}
+
 int main(int argc, char* argv[]) {
-    printf("utest: aaa (%i)\n", argc);
+    // run only knows whether there's a results stream once it has parsed -r
+    if (argc < 2 || strcmp(argv[1], "run") != 0)
+        banner(argc, argv);
 
     if (argc >= 2) {
-        printf("utest: %s\n", argv[1]);
-
         if (strcmp(argv[1], "cloexec") == 0) {
             int a = atoi(argv[2]);
             int b = atoi(argv[3]);
 
+            assert_init();
+
             ASSERT(close(a) == -1);
             ASSERT(close(b) != -1);
 
-            return 0;
+            return assert_failed() ? EXIT_FAILURE : 0;
         }
         else if (strcmp(argv[1], "exit") == 0)
             return 0;
+        else if (strcmp(argv[1], "bench") == 0)
+            return bench_main(argc - 2, argv + 2);
+        else if (strcmp(argv[1], "compare") == 0)
+            return bench_compare(argc - 1, argv + 1);
+        else if (strcmp(argv[1], "run") == 0)
+            return run_main(argc - 1, argv + 1);
         else if (strcmp(argv[1], "pagefault") == 0) {
             struct sigaction act;
 
@@ -100,8 +101,6 @@ int main(int argc, char* argv[]) {
             *((int*) 0xFFFF800000000002) = 'X';
         }
         else if (strcmp(argv[1], "invstack") == 0) {
-            nanosleep((const struct timespec[]){{0, 200000000L}}, NULL);
-
             struct sigaction act;
 
             act.sa_handler = fault_handler;
@@ -113,24 +112,357 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+    return run_groups(NULL, 0, sysconf(_SC_NPROCESSORS_ONLN), 30);
+}
+
+struct test_group {
+    const char* name;
+    void (*func)();
+};
 
+const struct test_group test_groups[] = {
 #if __aex__
-    test_file();
+    {"file", test_file},
 #endif
-
-    test_inet();
-    test_ctype();
-    test_string();
-    test_pdevs();
-    test_signals();
-    test_pthread();
-    // test_fb();
-
+    {"inet", test_inet},
+    {"ctype", test_ctype},
+    {"string", test_string},
+    {"string_boundary", test_string_boundary},
+    {"pdevs", test_pdevs},
+    {"signals", test_signals},
+    {"pthread", test_pthread},
+    // {"fb", test_fb},
 #if __aex__
-    test_aex();
+    {"aex", test_aex},
 #endif
+    {"stdio", test_stdio},
+};
+
+struct test_run {
+    const struct test_group* group;
+    pid_t                    pid;
+    FILE*                    output;
+    uint64_t                 start;
+    bool                     timed_out;
+};
+
+void run_sigchld(int sig) {}
+
+/* Forks the group off with its output going to a temporary file, so it can be printed in one go */
+void run_start(struct test_run* run, const sigset_t* mask, const struct sigaction* act) {
+    fflush(stdout);
+    fflush(stderr);
+
+    run->output = tmpfile();
+    ASSERT(run->output);
+
+    run->start = bench_now();
+    run->pid   = fork();
+
+    // own process group, so a timeout also takes down whatever the group has spawned
+    setpgid(run->pid, run->pid);
+
+    if (run->pid == 0) {
+        dup2(fileno(run->output), STDOUT_FILENO);
+        dup2(fileno(run->output), STDERR_FILENO);
+
+        // only now, the runner's own assertions are no tests of the group
+        assert_init();
+
+        sigaction(SIGCHLD, act, NULL);
+        sigprocmask(SIG_SETMASK, mask, NULL);
+
+        run->group->func();
+        exit(assert_failed() ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    ASSERT(run->pid != -1);
+}
+
+/*
+ * The group's output as a TAP subtest. Its assertion lines, and those of everything it spawned,
+ * are indented and planned, anything else the group printed is turned into comments.
+ */
+void run_subtest(struct test_run* run) {
+    char*   line  = NULL;
+    size_t  size  = 0;
+    size_t  count = 0;
+    ssize_t len;
+
+    printf("# Subtest: %s\n", run->group->name);
+
+    while ((len = getline(&line, &size, run->output)) != -1) {
+        bool result = strncmp(line, "ok ", 3) == 0 || strncmp(line, "not ok ", 7) == 0;
+
+        printf(result ? "    %s" : "    # %s", line);
+
+        if (line[len - 1] != '\n')
+            putchar('\n');
+
+        count += result;
+    }
+
+    printf("    1..%zu\n", count);
+    free(line);
+}
+
+/* Only the JSON lines stay on stdout, anything else the group printed goes to stderr */
+void run_json(struct test_run* run) {
+    char*   line = NULL;
+    size_t  size = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &size, run->output)) != -1) {
+        FILE* out = line[0] == '{' ? stdout : stderr;
+
+        fputs(line, out);
+
+        if (line[len - 1] != '\n')
+            fputc('\n', out);
+    }
+
+    free(line);
+}
+
+bool run_finish(struct test_run* run, int stat, int format, size_t number) {
+    uint64_t elapsed = bench_now() - run->start;
+    char     buffer[512];
+    char     status[32];
+    size_t   len;
+    bool     ok = false;
+
+    rewind(run->output);
+
+    if (format == ASSERT_TAP)
+        run_subtest(run);
+    else if (format == ASSERT_JSON)
+        run_json(run);
+    else
+        while ((len = fread(buffer, 1, sizeof(buffer), run->output)) > 0)
+            fwrite(buffer, 1, len, stdout);
+
+    fclose(run->output);
+
+    if (run->timed_out)
+        snprintf(status, sizeof(status), "timeout");
+    else if (WIFEXITED(stat) && WEXITSTATUS(stat) == EXIT_SUCCESS) {
+        snprintf(status, sizeof(status), "ok");
+        ok = true;
+    }
+    else if (WIFEXITED(stat))
+        snprintf(status, sizeof(status), "exit %i", WEXITSTATUS(stat));
+    else
+        snprintf(status, sizeof(status), "signal %i", WTERMSIG(stat));
+
+    if (format == ASSERT_TAP)
+        printf("%s %zu - %s # %s, %.3f ms\n", ok ? "ok" : "not ok", number, run->group->name,
+               status, elapsed / 1e6);
+    else
+        fprintf(format == ASSERT_JSON ? stderr : stdout, "utest: %-16s %-10s %10.3f ms\n",
+                run->group->name, status, elapsed / 1e6);
+
+    fflush(stdout);
+
+    return ok;
+}
+
+/*
+ * Runs every test group (or only the named ones) in its own child, at most jobs at a time. A
+ * group that runs for longer than timeout seconds is killed and counted as a failure. Returns -1
+ * without running anything if a name doesn't match any group.
+ */
+int run_groups(char* const* only, int only_count, long jobs, long timeout) {
+    size_t           count    = sizeof(test_groups) / sizeof(test_groups[0]);
+    struct test_run* runs     = calloc(count, sizeof(struct test_run));
+    size_t           selected = 0;
+
+    ASSERT(runs);
+
+    // a misspelt name would otherwise just leave its group out and let the run pass
+    for (int j = 0; j < only_count; j++) {
+        bool known = false;
+
+        for (size_t i = 0; i < count; i++)
+            if (strcmp(only[j], test_groups[i].name) == 0)
+                known = true;
+
+        if (!known) {
+            fprintf(stderr, "utest: no test group named %s\n", only[j]);
+            free(runs);
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        bool listed = only_count == 0;
+
+        for (int j = 0; j < only_count; j++)
+            if (strcmp(only[j], test_groups[i].name) == 0)
+                listed = true;
+
+        if (listed)
+            runs[selected++].group = &test_groups[i];
+    }
+
+    if (selected == 0) {
+        fprintf(stderr, "utest: no test groups to run\n");
+        free(runs);
+        return EXIT_FAILURE;
+    }
+
+    if (jobs < 1)
+        jobs = 1;
+
+    struct sigaction act = {};
+    struct sigaction old_act;
+    sigset_t         chld, old_mask;
+
+    act.sa_handler = run_sigchld;
+    act.sa_flags   = 0;
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+
+    sigaction(SIGCHLD, &act, &old_act);
+    sigprocmask(SIG_BLOCK, &chld, &old_mask);
+
+    uint64_t suite_start = bench_now();
+    int      format      = assert_env();
+    size_t   next        = 0;
+    size_t   running     = 0;
+    size_t   finished    = 0;
+    size_t   passed      = 0;
+
+    while (next < selected || running > 0) {
+        for (; running < (size_t) jobs && next < selected; running++)
+            run_start(&runs[next++], &old_mask, &old_act);
+
+        uint64_t now  = bench_now();
+        uint64_t wait = timeout * NSEC_PER_SEC;
+
+        for (size_t i = 0; i < next; i++) {
+            struct test_run* run      = &runs[i];
+            uint64_t         deadline = run->start + timeout * NSEC_PER_SEC;
+
+            if (run->pid == 0 || run->timed_out)
+                continue;
+
+            if (deadline <= now) {
+                kill(-run->pid, SIGKILL);
+                run->timed_out = true;
+            }
+            else if (deadline - now < wait)
+                wait = deadline - now;
+        }
+
+        sigtimedwait(&chld, NULL,
+                     (const struct timespec[]){{wait / NSEC_PER_SEC, wait % NSEC_PER_SEC}});
+
+        pid_t pid;
+        int   stat;
+
+        while ((pid = waitpid(-1, &stat, WNOHANG)) > 0) {
+            for (size_t i = 0; i < next; i++) {
+                if (runs[i].pid != pid)
+                    continue;
+
+                passed += run_finish(&runs[i], stat, format, ++finished);
+                runs[i].pid = 0;
+                running--;
+            }
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    sigaction(SIGCHLD, &old_act, NULL);
+
+    // the one plan of the whole run, with a group per test
+    if (format == ASSERT_TAP)
+        printf("1..%zu\n# ", selected);
+    else
+        fprintf(format == ASSERT_JSON ? stderr : stdout, "utest: ");
+
+    fprintf(format == ASSERT_JSON ? stderr : stdout, "%zu/%zu groups passed in %.3f ms\n", passed,
+            selected, (bench_now() - suite_start) / 1e6);
+
+    free(runs);
+    return passed == selected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void run_usage() {
+    fprintf(stderr, "usage: utest run [-j jobs] [-t timeout_s] [-r tap|json] [group...]\n");
+}
+
+/* A whole positive number, or -1 if arg is anything else */
+long run_positive(const char* arg) {
+    char* end;
+    long  value;
+
+    errno = 0;
+    value = strtol(arg, &end, 10);
+
+    if (errno != 0 || end == arg || *end != '\0' || value < 1)
+        return -1;
+
+    return value;
+}
+
+int run_main(int argc, char* argv[]) {
+    long jobs    = sysconf(_SC_NPROCESSORS_ONLN);
+    long timeout = 30;
+    int  opt;
+
+    while ((opt = getopt(argc, argv, "j:t:r:")) != -1) {
+        switch (opt) {
+        case 'j':
+            jobs = run_positive(optarg);
+
+            if (jobs == -1) {
+                fprintf(stderr, "utest: -j takes a positive number of jobs\n");
+                run_usage();
+                return EXIT_FAILURE;
+            }
+
+            break;
+        case 't':
+            timeout = run_positive(optarg);
+
+            if (timeout == -1) {
+                fprintf(stderr, "utest: -t takes a positive number of seconds\n");
+                run_usage();
+                return EXIT_FAILURE;
+            }
+
+            break;
+        case 'r':
+            // through the environment, so it reaches the groups and everything they spawn
+            setenv("UTEST_RESULTS", optarg, 1);
+
+            if (assert_env() == ASSERT_FATAL) {
+                run_usage();
+                return EXIT_FAILURE;
+            }
+
+            break;
+        default:
+            run_usage();
+            return EXIT_FAILURE;
+        }
+    }
 
+    banner(argc + 1, argv - 1);
+
+    int ret = run_groups(&argv[optind], argc - optind, jobs, timeout);
+
+    if (ret == -1) {
+        run_usage();
+        return EXIT_FAILURE;
+    }
+
+    return ret;
+}
+
+void test_stdio() {
     char buffer[256];
     gethostname(buffer, sizeof(buffer));
 
@@ -143,8 +475,6 @@ int main(int argc, char* argv[]) {
 
     snprintf(buffer, 4, "%s", "abcdefgh");
     printf("%s\n", buffer);
-
-    return 0;
 }
 
 void test_pipes();
@@ -212,20 +542,25 @@ void test_file() {
         ASSERT(close(closetest) == 0);
     }
 
-    FILE* utest_file = fopen("utest", "r");
+    FILE*            utest_file = fopen("utest", "r");
+    struct handshake seeked;
+
+    handshake_init(&seeked);
 
     if (fork() == 0) {
-        nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+        handshake_wait(&seeked);
         ASSERT(ftell(utest_file) == 6);
         exit(EXIT_SUCCESS);
     }
     else {
         ASSERT(fseek(utest_file, 6, SEEK_SET) == 0);
+        handshake_post(&seeked);
 
         int stat;
         wait(&stat);
 
         ASSERT(stat == EXIT_SUCCESS);
+        handshake_destroy(&seeked);
     }
 }
 
@@ -240,16 +575,20 @@ void test_pipes() {
     // ASSERT(write(des[0], "abcdef", 6) == -1);
     ASSERT(memcmp(buff, "abcdef", 6) == 0);
 
+    struct handshake first_read;
+    handshake_init(&first_read);
+
     pid_t ff = fork();
     if (ff == 0) {
         ASSERT(read(des[0], buff, 6) == 2);
+        handshake_post(&first_read);
         ASSERT(read(des[0], buff, 6) == 4);
 
         exit(EXIT_SUCCESS);
     }
 
     ASSERT(write(des[1], buff, 2) == 2);
-    nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+    handshake_wait(&first_read);
     ASSERT(write(des[1], buff, 4) == 4);
 
     int stat;
@@ -259,6 +598,8 @@ void test_pipes() {
 
     ASSERT(close(des[0]) == 0);
     ASSERT(close(des[1]) == 0);
+
+    handshake_destroy(&first_read);
 }
 
 void test_inet() {
@@ -268,6 +609,91 @@ void test_inet() {
     ASSERT(ntohs(0x0001) == 0x0100);
 }
 
+#define CTYPE_ALNUM  0x001
+#define CTYPE_ALPHA  0x002
+#define CTYPE_BLANK  0x004
+#define CTYPE_CNTRL  0x008
+#define CTYPE_DIGIT  0x010
+#define CTYPE_GRAPH  0x020
+#define CTYPE_LOWER  0x040
+#define CTYPE_PRINT  0x080
+#define CTYPE_PUNCT  0x100
+#define CTYPE_SPACE  0x200
+#define CTYPE_UPPER  0x400
+#define CTYPE_XDIGIT 0x800
+
+struct ctype_class {
+    const char* name;
+    int (*func)(int c);
+    int class;
+};
+
+const struct ctype_class ctype_classes[] = {
+    {"isalnum", isalnum, CTYPE_ALNUM},
+    {"isalpha", isalpha, CTYPE_ALPHA},
+    {"isblank", isblank, CTYPE_BLANK},
+    {"iscntrl", iscntrl, CTYPE_CNTRL},
+    {"isdigit", isdigit, CTYPE_DIGIT},
+    {"isgraph", isgraph, CTYPE_GRAPH},
+    {"islower", islower, CTYPE_LOWER},
+    {"isprint", isprint, CTYPE_PRINT},
+    {"ispunct", ispunct, CTYPE_PUNCT},
+    {"isspace", isspace, CTYPE_SPACE},
+    {"isupper", isupper, CTYPE_UPPER},
+    {"isxdigit", isxdigit, CTYPE_XDIGIT},
+};
+
+/*
+ * The classes of c in the C locale, straight from the ASCII ranges POSIX gives them. EOF and
+ * everything above 0x7F belong to none.
+ */
+int ctype_reference(int c) {
+    int class = 0;
+
+    if (c < 0 || c > 0x7F)
+        return 0;
+
+    if (c >= 'a' && c <= 'z')
+        class |= CTYPE_LOWER | CTYPE_ALPHA;
+    else if (c >= 'A' && c <= 'Z')
+        class |= CTYPE_UPPER | CTYPE_ALPHA;
+    else if (c >= '0' && c <= '9')
+        class |= CTYPE_DIGIT;
+
+    if (class & (CTYPE_ALPHA | CTYPE_DIGIT))
+        class |= CTYPE_ALNUM;
+
+    if ((class & CTYPE_DIGIT) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+        class |= CTYPE_XDIGIT;
+
+    if (c == ' ' || c == '\t')
+        class |= CTYPE_BLANK;
+
+    if (c == ' ' || (c >= '\t' && c <= '\r'))
+        class |= CTYPE_SPACE;
+
+    if (c < 0x20 || c == 0x7F)
+        class |= CTYPE_CNTRL;
+    else
+        class |= CTYPE_PRINT;
+
+    if (c > 0x20 && c < 0x7F)
+        class |= CTYPE_GRAPH;
+
+    if ((class & CTYPE_GRAPH) && !(class & CTYPE_ALNUM))
+        class |= CTYPE_PUNCT;
+
+    return class;
+}
+
+/* Names the function and the character that went wrong, the assertion alone can't */
+bool ctype_check(const char* func, int c, bool ok) {
+    if (!ok)
+        fprintf(stderr, "%s(%d) doesn't match the C locale\n", func, c);
+
+    return ok;
+}
+
 void test_ctype() {
     ASSERT(isalnum('a'));
     ASSERT(isalnum('Y'));
@@ -331,6 +757,29 @@ void test_ctype() {
     ASSERT(_toupper('z') == 'Z');
     ASSERT(_tolower('A') == 'a');
     ASSERT(_tolower('Z') == 'z');
+
+    // every function over its whole domain, a bad table entry anywhere fails here
+    for (int c = EOF; c <= UCHAR_MAX; c++) {
+        int class = ctype_reference(c);
+
+        for (size_t i = 0; i < sizeof(ctype_classes) / sizeof(ctype_classes[0]); i++) {
+            const struct ctype_class* ct = &ctype_classes[i];
+            ASSERT(ctype_check(ct->name, c, !ct->func(c) == !(class & ct->class)));
+        }
+
+        int upper = class & CTYPE_LOWER ? c - 'a' + 'A' : c;
+        int lower = class & CTYPE_UPPER ? c - 'A' + 'a' : c;
+
+        ASSERT(ctype_check("toupper", c, toupper(c) == upper));
+        ASSERT(ctype_check("tolower", c, tolower(c) == lower));
+
+        // these two are only defined for letters of the right case
+        if (class & CTYPE_LOWER)
+            ASSERT(ctype_check("_toupper", c, _toupper(c) == upper));
+
+        if (class & CTYPE_UPPER)
+            ASSERT(ctype_check("_tolower", c, _tolower(c) == lower));
+    }
 }
 
 void test_string() {
@@ -536,6 +985,215 @@ void test_string() {
     ASSERT(strtok_r(buffer, " ,", &ptr) == NULL);
 }
 
+const char* boundary_func;
+size_t      boundary_offset;
+
+void boundary_fault_handler(int sig) {
+    fprintf(stderr, "%s faulted at page offset %zu\n", boundary_func, boundary_offset);
+    exit(0x80 | sig);
+}
+
+/* Maps a read-write page with a PROT_NONE page on either side of it */
+char* guarded_page(size_t page) {
+    char* map = mmap(NULL, page * 3, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(map != MAP_FAILED);
+    ASSERT(mprotect(map + page, page, PROT_READ | PROT_WRITE) == 0);
+
+    return map + page;
+}
+
+bool all_bytes(const char* ptr, char c, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (ptr[i] != c)
+            return false;
+
+    return true;
+}
+
+/*
+ * Runs the string functions on buffers that end flush against a guard page, starting at every
+ * offset of the page, so any read or write past the end of the buffer faults.
+ */
+void test_string_boundary() {
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    char* a = guarded_page(page);
+    char* b = guarded_page(page);
+    char* d = guarded_page(page);
+
+    struct sigaction act = {};
+    struct sigaction old_segv, old_bus;
+
+    act.sa_handler = boundary_fault_handler;
+    act.sa_flags   = 0;
+
+    sigaction(SIGSEGV, &act, &old_segv);
+    sigaction(SIGBUS, &act, &old_bus);
+
+    for (size_t o = 0; o < page; o++) {
+        size_t n   = page - o;
+        size_t len = n - 1;
+        char*  s   = &a[o];
+        char*  t   = &b[o];
+        char*  dst = &d[o];
+
+        boundary_offset = o;
+
+        memset(a, 'a', page);
+        memset(b, 'a', page);
+        a[page - 1] = '\0';
+        b[page - 1] = '\0';
+
+        // mem*
+        boundary_func = "memchr";
+        ASSERT(memchr(s, 'z', n) == NULL);
+        ASSERT(memchr(s, '\0', n) == &s[len]);
+
+        boundary_func = "memcmp";
+        ASSERT(memcmp(s, t, n) == 0);
+
+        boundary_func = "memcpy";
+        memset(d, 'b', page);
+        ASSERT(memcpy(dst, s, n) == dst);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "memmove";
+        memset(d, 'b', page);
+        ASSERT(memmove(dst, s, n) == dst);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "memset";
+        ASSERT(memset(dst, 'c', n) == dst);
+        ASSERT(all_bytes(dst, 'c', n));
+
+        boundary_func = "memccpy";
+        ASSERT(memccpy(dst, s, 'z', n) == NULL);
+        ASSERT(memccpy(dst, s, '\0', n) == &dst[n]);
+
+        // str*
+        boundary_func = "strlen";
+        ASSERT(strlen(s) == len);
+
+        boundary_func = "strchr";
+        ASSERT(strchr(s, 'z') == NULL);
+        ASSERT(strchr(s, '\0') == &s[len]);
+
+        boundary_func = "strrchr";
+        ASSERT(strrchr(s, 'z') == NULL);
+        ASSERT(strrchr(s, 'a') == (len ? &s[len - 1] : NULL));
+
+        boundary_func = "strcmp";
+        ASSERT(strcmp(s, t) == 0);
+
+        boundary_func = "strncmp";
+        ASSERT(strncmp(s, t, page * 2) == 0);
+
+        boundary_func = "strcpy";
+        memset(d, 'b', page);
+        ASSERT(strcpy(dst, s) == dst);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "stpcpy";
+        memset(d, 'b', page);
+        ASSERT(stpcpy(dst, s) == &dst[len]);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "strncpy";
+        memset(d, 'b', page);
+        ASSERT(strncpy(dst, s, n) == dst);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "strcat";
+        memset(d, 'b', page);
+        dst[0] = '\0';
+        ASSERT(strcat(dst, s) == dst);
+        ASSERT(all_bytes(dst, 'a', len) && dst[len] == '\0');
+
+        boundary_func = "strspn";
+        ASSERT(strspn(s, "a") == len);
+
+        boundary_func = "strcspn";
+        ASSERT(strcspn(s, "z") == len);
+
+        boundary_func = "strpbrk";
+        ASSERT(strpbrk(s, "z") == NULL);
+
+        boundary_func = "strstr";
+        ASSERT(strstr(s, "zz") == NULL);
+        ASSERT(strstr(s, "") == s);
+        ASSERT(strstr(s, t) == s);
+
+        boundary_func = "strtok";
+        ASSERT(strtok(s, "z") == (len ? s : NULL));
+        ASSERT(strtok(NULL, "z") == NULL);
+
+        char* ptr = NULL;
+
+        boundary_func = "strtok_r";
+        ASSERT(strtok_r(s, "z", &ptr) == (len ? s : NULL));
+        ASSERT(strtok_r(NULL, "z", &ptr) == NULL);
+
+        if (len == 0)
+            continue;
+
+        // a match in the last byte before the terminator
+        s[len - 1] = 'z';
+
+        boundary_func = "memchr";
+        ASSERT(memchr(s, 'z', n) == &s[len - 1]);
+
+        boundary_func = "memcmp";
+        ASSERT(memcmp(s, t, n) > 0);
+
+        boundary_func = "strchr";
+        ASSERT(strchr(s, 'z') == &s[len - 1]);
+
+        boundary_func = "strrchr";
+        ASSERT(strrchr(s, 'z') == &s[len - 1]);
+
+        boundary_func = "strcmp";
+        ASSERT(strcmp(s, t) > 0);
+
+        boundary_func = "strncmp";
+        ASSERT(strncmp(s, t, page * 2) > 0);
+
+        boundary_func = "strspn";
+        ASSERT(strspn(s, "a") == len - 1);
+
+        boundary_func = "strcspn";
+        ASSERT(strcspn(s, "z") == len - 1);
+
+        boundary_func = "strpbrk";
+        ASSERT(strpbrk(s, "z") == &s[len - 1]);
+
+        boundary_func = "strstr";
+        ASSERT(strstr(s, "z") == &s[len - 1]);
+
+        // needle and sets that end flush against the guard page as well
+        char* set = &b[page - 2];
+        set[0]    = 'z';
+
+        boundary_func = "strspn";
+        ASSERT(strspn(s, set) == (len == 1));
+
+        boundary_func = "strcspn";
+        ASSERT(strcspn(s, set) == len - 1);
+
+        boundary_func = "strpbrk";
+        ASSERT(strpbrk(s, set) == &s[len - 1]);
+
+        boundary_func = "strstr";
+        ASSERT(strstr(s, set) == &s[len - 1]);
+    }
+
+    sigaction(SIGSEGV, &old_segv, NULL);
+    sigaction(SIGBUS, &old_bus, NULL);
+
+    ASSERT(munmap(a - page, page * 3) == 0);
+    ASSERT(munmap(b - page, page * 3) == 0);
+    ASSERT(munmap(d - page, page * 3) == 0);
+}
+
 void test_pdevs() {
     char buffer[4];
 
@@ -754,7 +1412,7 @@ void test_signals() {
     ASSERT(sigwaitinfo(&set, &info) == SIGUSR1);
     ASSERT(info.si_signo == SIGUSR1);
 
-    int ret        = sigtimedwait(&set, &info, (const struct timespec[]){{0, 100000000L}});
+    int ret        = sigtimedwait(&set, &info, (const struct timespec[]){{0, 0}});
     int errno_pres = errno;
 
     ASSERT(ret == -1);
@@ -839,6 +1497,7 @@ void test_pthread() {
 }
 
 void* test_pthread_defcancel_secondary(void* arg) {
+    handshake_post(arg);
     sleep(1000);
     pthread_testcancel();
 
@@ -849,19 +1508,25 @@ void* test_pthread_defcancel_secondary(void* arg) {
 }
 
 void test_pthread_defcancel() {
-    pthread_t thread;
-    void*     retval;
+    pthread_t        thread;
+    void*            retval;
+    struct handshake started;
+
+    handshake_init(&started);
 
-    ASSERT(pthread_create(&thread, NULL, test_pthread_defcancel_secondary, NULL) == 0);
-    nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+    ASSERT(pthread_create(&thread, NULL, test_pthread_defcancel_secondary, &started) == 0);
+    handshake_wait(&started);
 
     ASSERT(pthread_cancel(thread) == 0);
     ASSERT(pthread_join(thread, &retval) == 0);
     ASSERT(retval == PTHREAD_CANCELED);
+
+    handshake_destroy(&started);
 }
 
 void* test_pthread_asynccancel_secondary(void* arg) {
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    handshake_post(arg);
 
     while (true)
         ;
@@ -870,13 +1535,18 @@ void* test_pthread_asynccancel_secondary(void* arg) {
 }
 
 void test_pthread_asynccancel() {
-    pthread_t thread;
+    pthread_t        thread;
+    struct handshake started;
+
+    handshake_init(&started);
 
-    ASSERT(pthread_create(&thread, NULL, test_pthread_asynccancel_secondary, NULL) == 0);
-    nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+    ASSERT(pthread_create(&thread, NULL, test_pthread_asynccancel_secondary, &started) == 0);
+    handshake_wait(&started);
 
     ASSERT(pthread_cancel(thread) == 0);
     ASSERT(pthread_join(thread, NULL) == 0);
+
+    handshake_destroy(&started);
 }
 
 void test_pthread_masking_handler(int sig) {
@@ -909,8 +1579,9 @@ void* test_pthread_canceltoggle_secondary(void* arg) {
 
     canceltoggle_test = 1;
 
+    // the cancel has been pending all along, acted on at the first cancellation point
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    nanosleep((const struct timespec[]){{0, 100000000L}}, NULL);
+    pthread_testcancel();
 
     canceltoggle_test = 2;
     return NULL;
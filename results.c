@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "utest.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ASSERT_LOG_SIZE 1048576
+
+struct assert_entry {
+    const char* file;
+    const char* expr;
+    uint64_t    elapsed;
+    int         line;
+    int         err;
+    bool        passed;
+};
+
+int assert_format = ASSERT_FATAL;
+
+/*
+ * Allocated once up front and claimed with an atomic counter, so recording is safe from threads
+ * and signal handlers alike and never allocates.
+ */
+static struct assert_entry* assert_log;
+static size_t               assert_count;
+static bool                 assert_any_failed;
+
+uint64_t assert_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void assert_record(const char* file, int line, const char* expr, bool passed, int err,
+                   uint64_t elapsed) {
+    size_t index = __atomic_fetch_add(&assert_count, 1, __ATOMIC_RELAXED);
+
+    if (!passed)
+        assert_any_failed = true;
+
+    if (index >= ASSERT_LOG_SIZE)
+        return;
+
+    struct assert_entry* entry = &assert_log[index];
+
+    entry->file    = file;
+    entry->line    = line;
+    entry->expr    = expr;
+    entry->passed  = passed;
+    entry->err     = err;
+    entry->elapsed = elapsed;
+}
+
+bool assert_failed() {
+    return assert_any_failed;
+}
+
+static void json_string(const char* str) {
+    putchar('"');
+
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            printf("\\%c", *str);
+        else if ((unsigned char) *str < 0x20)
+            printf("\\u%04x", *str);
+        else
+            putchar(*str);
+    }
+
+    putchar('"');
+}
+
+static void tap_description(const char* str) {
+    for (; *str; str++) {
+        if (*str == '#')
+            putchar('\\');
+
+        putchar(*str);
+    }
+}
+
+static void assert_dump() {
+    size_t count = assert_count < ASSERT_LOG_SIZE ? assert_count : ASSERT_LOG_SIZE;
+    pid_t  pid   = getpid();
+
+    if (count == 0)
+        return;
+
+    for (size_t i = 0; i < count; i++) {
+        struct assert_entry* entry = &assert_log[i];
+
+        // unnumbered, the runner counts them up and plans them as one subtest per group
+        if (assert_format == ASSERT_TAP) {
+            printf("%s - %s:%i: ", entry->passed ? "ok" : "not ok", entry->file, entry->line);
+            tap_description(entry->expr);
+
+            if (entry->passed)
+                printf(" # %llu ns\n", (unsigned long long) entry->elapsed);
+            else
+                printf(" # errno = \"%s\", %llu ns\n", strerror(entry->err),
+                       (unsigned long long) entry->elapsed);
+
+            continue;
+        }
+
+        // one object per line, so the logs of several processes can simply be concatenated
+        printf("{\"pid\": %i, \"file\": ", (int) pid);
+        json_string(entry->file);
+        printf(", \"line\": %i, \"expr\": ", entry->line);
+        json_string(entry->expr);
+        printf(", \"passed\": %s, \"errno\": %i, \"ns\": %llu}\n", entry->passed ? "true" : "false",
+               entry->err, (unsigned long long) entry->elapsed);
+    }
+
+    if (assert_format == ASSERT_TAP && assert_count > count)
+        printf("# %zu assertions past the first %zu were not logged\n", assert_count - count,
+               count);
+
+    fflush(stdout);
+}
+
+/* A forked child only reports the assertions it made itself */
+static void assert_atfork_child() {
+    assert_count      = 0;
+    assert_any_failed = false;
+}
+
+int assert_env() {
+    const char* format = getenv("UTEST_RESULTS");
+
+    if (format && strcmp(format, "tap") == 0)
+        return ASSERT_TAP;
+    else if (format && strcmp(format, "json") == 0)
+        return ASSERT_JSON;
+
+    return ASSERT_FATAL;
+}
+
+void assert_init() {
+    static bool registered = false;
+
+    assert_format = assert_env();
+
+    if (assert_format == ASSERT_FATAL || registered)
+        return;
+
+    registered = true;
+    assert_log = calloc(ASSERT_LOG_SIZE, sizeof(struct assert_entry));
+
+    if (!assert_log) {
+        fprintf(stderr, "utest: can't allocate the assertion log\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atexit(assert_dump);
+    pthread_atfork(NULL, NULL, assert_atfork_child);
+}